@@ -0,0 +1,164 @@
+#include "autoplay.h"
+
+#include "planner.h"
+
+// El-Tetris weights for Dellacherie's features.
+const EvalWeights kDefaultEvalWeights = {
+    .landingHeight = -4.500158825082766,
+    .rowsCleared = 3.4181268101392694,
+    .rowTransitions = -3.2178882868487753,
+    .columnTransitions = -9.348695305445199,
+    .holes = -7.899265427351652,
+    .cumulativeWells = -3.3855972247263626};
+
+// Pieces searched per decision: the falling one and the next one.
+enum { kAutoplayDepth = 2 };
+
+// Score of a plan that ends the game.
+static const double kLosingScore = -1e12;
+
+bool autoplayApply(GameState* gs, const AutoplayPlan* plan,
+                   double* landingHeight, int* rowsCleared) {
+  for (int i = 0; i < plan->rotations; ++i) {
+    int before = gs->rotationIndex;
+    rotateTetromino(gs);
+    if (gs->rotationIndex == before) {
+      return false;
+    }
+  }
+  // Сдвиги бота применяются без шага падения, как их применяет
+  // autoplayStep(), поэтому фигура доходит до цели на строке появления.
+  UserAction direction = plan->shift < 0 ? kActionLeft : kActionRight;
+  for (int i = abs(plan->shift); i > 0; --i) {
+    if (!shiftTetromino(gs, direction)) {
+      return false;
+    }
+  }
+  FsmState state = kFalling;
+  hardDropState(gs, &state);
+  const PieceMask* piece = &kPieceMasks[gs->tetrominoType][gs->rotationIndex];
+  *landingHeight =
+      kRow - (gs->tetrominoY + piece->top) - (piece->height - 1) / 2.0;
+  int lines = gs->linesCleared;
+  lockTetromino(gs);
+  clearLinesState(gs, &state);
+  *rowsCleared = gs->linesCleared - lines;
+  return true;
+}
+
+double autoplayEvaluate(const GameState* gs, const EvalWeights* weights) {
+  BoardFeatures features;
+  extractFeatures(gs->board, &features);
+  return weights->rowTransitions * features.rowTransitions +
+         weights->columnTransitions * features.columnTransitions +
+         weights->holes * features.holes +
+         weights->cumulativeWells * features.cumulativeWells;
+}
+
+/**
+ * Searches every plan of the falling tetromino and, below depth 1, of the
+ * tetrominoes after it.
+ * @param gs Pointer to the game state with a falling tetromino.
+ * @param weights Evaluator weights.
+ * @param depth Number of tetrominoes to place.
+ * @param best Pointer to receive the best plan (may be NULL).
+ * @return Score of the best plan, kLosingScore if the game ends.
+ */
+static double searchPlans(const GameState* gs, const EvalWeights* weights,
+                          int depth, AutoplayPlan* best) {
+  double bestScore = kLosingScore;
+  bool found = false;
+  int rotations = getRotationsPerTetromino()[gs->tetrominoType];
+  for (int r = 0; r < rotations; ++r) {
+    for (int shift = -kCol; shift <= kCol; ++shift) {
+      AutoplayPlan plan = {r, shift};
+      GameState child = *gs;
+      double landingHeight;
+      int rowsCleared;
+      if (!autoplayApply(&child, &plan, &landingHeight, &rowsCleared)) {
+        continue;
+      }
+      double score = weights->landingHeight * landingHeight +
+                     weights->rowsCleared * rowsCleared;
+      int next = child.nextTetrominoType;
+      if (depth <= 1 || next == kNoTetromino) {
+        score += autoplayEvaluate(&child, weights);
+      } else {
+        const PieceMask* spawn = &kPieceMasks[next][0];
+        if (fits(&child, next, 0, spawn->spawnX, spawn->spawnY)) {
+          spawnTetromino(&child, spawn->spawnX, spawn->spawnY, next, 0);
+          score += searchPlans(&child, weights, depth - 1, NULL);
+        } else {
+          score += kLosingScore;
+        }
+      }
+      if (!found || score > bestScore) {
+        bestScore = score;
+        found = true;
+        if (best) {
+          *best = plan;
+        }
+      }
+    }
+  }
+  return bestScore;
+}
+
+bool autoplayChoose(const GameState* gs, const EvalWeights* weights,
+                    AutoplayPlan* plan) {
+  if (!gs->pieceActive) {
+    return false;
+  }
+  searchPlans(gs, weights, kAutoplayDepth, plan);
+  return true;
+}
+
+bool autoplayStep(Autoplay* bot, TetrisGame* game) {
+  const GameState* gs = &game->state;
+  if (!gs->pieceActive) {
+    bot->planned = false;
+    return false;
+  }
+  if (gs->state != kFalling) {
+    return false;
+  }
+  if (!bot->planned) {
+    AutoplayPlan plan;
+    bool chosen = bot->planner
+                      ? plannerChoose(bot->planner, gs, &plan, NULL)
+                      : autoplayChoose(gs, bot->weights, &plan);
+    if (!chosen) {
+      return false;
+    }
+    GameState target = *gs;
+    for (int i = 0; i < plan.rotations; ++i) {
+      rotateTetromino(&target);
+    }
+    bot->rotation = target.rotationIndex;
+    bot->x = target.tetrominoX + plan.shift;
+    bot->planned = true;
+  }
+  UserAction action = kActionDown;
+  if (gs->rotationIndex != bot->rotation) {
+    action = kActionRotate;
+  } else if (gs->tetrominoX > bot->x) {
+    action = kActionLeft;
+  } else if (gs->tetrominoX < bot->x) {
+    action = kActionRight;
+  }
+  int before = gs->rotationIndex;
+  int x = gs->tetrominoX;
+  tetris_userInputBatch(game, &action, NULL, 1);
+  // Сдвиг выполняется сразу, без шага падения, как в autoplayApply().
+  tetris_applyPendingShift(game);
+  // Поворот или сдвиг, упёршийся в препятствие, не повторяется: фигура
+  // падает как есть.
+  if (action == kActionRotate && gs->rotationIndex == before) {
+    bot->rotation = before;
+  }
+  if ((action == kActionLeft || action == kActionRight) &&
+      gs->tetrominoX == x) {
+    bot->x = x;
+  }
+  return gs->state == kFalling;
+}
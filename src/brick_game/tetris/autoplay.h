@@ -0,0 +1,94 @@
+#ifndef TETRIS_AUTOPLAY_H_
+#define TETRIS_AUTOPLAY_H_
+
+#include "board_features.h"
+#include "tetris.h"
+
+// Weights of the placement evaluator. A placement scores the weighted sum
+// of its landing height, the rows it clears and the features of the board
+// it leaves behind.
+typedef struct {
+  double landingHeight;      // Height of the piece's middle row.
+  double rowsCleared;        // Lines cleared by the placement.
+  double rowTransitions;     // BoardFeatures.rowTransitions.
+  double columnTransitions;  // BoardFeatures.columnTransitions.
+  double holes;              // BoardFeatures.holes.
+  double cumulativeWells;    // BoardFeatures.cumulativeWells.
+} EvalWeights;
+
+// Default weights, tuned for single-piece play on a 10-wide field.
+extern const EvalWeights kDefaultEvalWeights;
+
+// Upper bound on the plans of one tetromino: every rotation with every
+// shift from -kCol to kCol.
+enum { kMaxAutoplayPlans = 4 * (2 * kCol + 1) };
+
+// Move the bot steers the falling tetromino towards: rotate in place at
+// the spawn row, shift sideways, then hard drop.
+typedef struct {
+  int rotations;  // Rotate presses.
+  int shift;      // Columns to move, negative for left.
+} AutoplayPlan;
+
+typedef struct BeamPlanner BeamPlanner;
+
+// Bot state between calls to autoplayStep().
+typedef struct {
+  const EvalWeights* weights;  // Evaluator weights.
+  BeamPlanner* planner;        // Planner, NULL for autoplayChoose().
+  bool planned;                // A target was chosen for the current piece.
+  int rotation;                // Target rotation index.
+  int x;                       // Target x-coordinate.
+} Autoplay;
+
+/**
+ * Plays a plan out on a state whose tetromino is falling, locks the
+ * tetromino and clears lines.
+ * @param gs Pointer to the game state to play on.
+ * @param plan The plan.
+ * @param landingHeight Pointer to receive the height of the piece's middle.
+ * @param rowsCleared Pointer to receive the lines cleared.
+ * @return False if a rotation or move of the plan is blocked, which makes
+ * the plan a duplicate of a shorter one.
+ */
+bool autoplayApply(GameState* gs, const AutoplayPlan* plan,
+                   double* landingHeight, int* rowsCleared);
+
+/**
+ * Scores a board with the feature terms of the evaluator.
+ * @param gs Pointer to the game state.
+ * @param weights Evaluator weights.
+ * @return The weighted board features.
+ */
+double autoplayEvaluate(const GameState* gs, const EvalWeights* weights);
+
+/**
+ * Picks the best plan for the falling tetromino. Every plan is played out
+ * on a copy of the state with the engine's own rotate, move and drop
+ * steps, and scored together with the best follow-up plan for the next
+ * tetromino (one-piece lookahead).
+ * @param gs Pointer to the game state with a freshly spawned tetromino.
+ * @param weights Evaluator weights.
+ * @param plan Pointer to receive the plan.
+ * @return False if no tetromino is falling.
+ */
+bool autoplayChoose(const GameState* gs, const EvalWeights* weights,
+                    AutoplayPlan* plan);
+
+/**
+ * Sends the next action of the bot through tetris_userInputBatch(), so a
+ * replay resolves a pending shift the same way the frontend does. A
+ * target is chosen when a new tetromino appears, by the planner if the
+ * bot has one; after that each call compares the falling tetromino with
+ * the target and issues one rotate, one sideways move or the final drop.
+ * A sideways move is applied at once with tetris_applyPendingShift(),
+ * without a gravity step, as autoplayApply() plays it. Calls while the engine is busy with the previous action do nothing, so
+ * the function may be called as often as the frontend likes.
+ * @param bot The bot state (weights set, the rest zeroed at start).
+ * @param game The game instance.
+ * @return True if an action was sent and the tetromino is still falling,
+ * so the next action may follow without waiting for a tick.
+ */
+bool autoplayStep(Autoplay* bot, TetrisGame* game);
+
+#endif
@@ -0,0 +1,465 @@
+#include "batch.h"
+
+// Field row of a lane with no cells set: only the walls.
+static const uint16_t kEmptyLaneRow =
+    (uint16_t)~((unsigned)kFullRow << kBatchWall);
+
+/**
+ * Allocates a lane array with 64-byte alignment.
+ * @param bytes Size of the array.
+ * @return The array, NULL on allocation failure.
+ */
+static void* allocLanes(size_t bytes) {
+  return aligned_alloc(64, (bytes + 63) / 64 * 64);
+}
+
+TetrisBatch* tetris_batchCreate(int count, PieceRandomizer randomizer) {
+  if (count < 1) {
+    fprintf(stderr, "Invalid batch size %d\n", count);
+    return NULL;
+  }
+  TetrisBatch* batch = calloc(1, sizeof(TetrisBatch));
+  if (!batch) {
+    fprintf(stderr, "Failed to allocate game batch\n");
+    return NULL;
+  }
+  int lanes = (count + kBatchLanes - 1) / kBatchLanes * kBatchLanes;
+  batch->count = count;
+  batch->lanes = lanes;
+  batch->randomizer = randomizer;
+  batch->rows = allocLanes((size_t)kBatchRows * lanes * sizeof(uint16_t));
+  batch->state = allocLanes(lanes * sizeof(uint8_t));
+  batch->x = allocLanes(lanes * sizeof(int16_t));
+  batch->y = allocLanes(lanes * sizeof(int16_t));
+  batch->type = allocLanes(lanes * sizeof(int8_t));
+  batch->rotation = allocLanes(lanes * sizeof(int8_t));
+  batch->next = allocLanes(lanes * sizeof(int8_t));
+  batch->score = allocLanes(lanes * sizeof(int));
+  batch->level = allocLanes(lanes * sizeof(int));
+  batch->pointsTowardLevel = allocLanes(lanes * sizeof(int));
+  batch->lines = allocLanes(lanes * sizeof(int));
+  batch->randomState = allocLanes(lanes * sizeof(uint64_t));
+  batch->bagLeft = allocLanes(lanes * sizeof(uint8_t));
+  batch->tickState = allocLanes(lanes * sizeof(uint8_t));
+  batch->placed = allocLanes(kFigureSize * lanes * sizeof(uint16_t));
+  batch->pending = allocLanes(lanes * sizeof(uint8_t));
+  batch->full = allocLanes(lanes * sizeof(uint8_t));
+  if (!batch->rows || !batch->state || !batch->x || !batch->y ||
+      !batch->type || !batch->rotation || !batch->next || !batch->score ||
+      !batch->level || !batch->pointsTowardLevel || !batch->lines ||
+      !batch->randomState || !batch->bagLeft || !batch->tickState ||
+      !batch->placed || !batch->pending || !batch->full) {
+    fprintf(stderr, "Failed to allocate game batch\n");
+    tetris_batchDestroy(batch);
+    return NULL;
+  }
+  for (int g = 0; g < lanes; ++g) {
+    tetris_batchReset(batch, g, (uint64_t)g);
+    if (g >= count) {
+      batch->state[g] = kGameOver;
+    }
+  }
+  return batch;
+}
+
+void tetris_batchDestroy(TetrisBatch* batch) {
+  if (!batch) {
+    return;
+  }
+  free(batch->rows);
+  free(batch->state);
+  free(batch->x);
+  free(batch->y);
+  free(batch->type);
+  free(batch->rotation);
+  free(batch->next);
+  free(batch->score);
+  free(batch->level);
+  free(batch->pointsTowardLevel);
+  free(batch->lines);
+  free(batch->randomState);
+  free(batch->bagLeft);
+  free(batch->tickState);
+  free(batch->placed);
+  free(batch->pending);
+  free(batch->full);
+  free(batch);
+}
+
+void tetris_batchReset(TetrisBatch* batch, int game, uint64_t seed) {
+  int lanes = batch->lanes;
+  for (int r = 0; r < kBatchRows; ++r) {
+    bool wall = r < kBatchPad || r >= kBatchPad + kRow;
+    batch->rows[r * lanes + game] = wall ? kBatchFullRow : kEmptyLaneRow;
+  }
+  // Тот же посев генератора, что и в tetris_seed().
+  uint64_t* randomState = &batch->randomState[game];
+  *randomState = 0;
+  randomNext(randomState);
+  *randomState += seed;
+  randomNext(randomState);
+  batch->bagLeft[game] = 0;
+  batch->state[game] = kSpawn;
+  batch->x[game] = 0;
+  batch->y[game] = 0;
+  batch->type[game] = 0;
+  batch->rotation[game] = 0;
+  batch->next[game] = kNoTetromino;
+  batch->score[game] = 0;
+  batch->level[game] = 1;
+  batch->pointsTowardLevel[game] = 0;
+  batch->lines[game] = 0;
+  for (int i = 0; i < kFigureSize; ++i) {
+    batch->placed[i * lanes + game] = 0;
+  }
+}
+
+/**
+ * Places a grid row mask of a piece at field column x of a lane row.
+ * @param row Row mask in grid coordinates.
+ * @param x Field x-coordinate of the grid's left edge (>= -kFigureSize).
+ * @return The row mask in lane row coordinates.
+ */
+static inline uint16_t laneRow(unsigned row, int x) {
+  return (uint16_t)((row << (x + kFigureSize + kBatchWall)) >> kFigureSize);
+}
+
+/**
+ * Tests whether a piece fits in one lane.
+ * @param batch The batch.
+ * @param game Lane of the game.
+ * @param type Tetromino type.
+ * @param rotation Rotation index.
+ * @param x Field x-coordinate of the grid.
+ * @param y Field y-coordinate of the grid (-kBatchPad to kRow).
+ * @return True if no cell of the piece overlaps a cell or wall.
+ */
+static bool fitsLane(const TetrisBatch* batch, int game, int type,
+                     int rotation, int x, int y) {
+  const PieceMask* piece = &kPieceMasks[type][rotation];
+  int lanes = batch->lanes;
+  const uint16_t* rows = &batch->rows[(y + kBatchPad) * lanes + game];
+  uint16_t hit = 0;
+  for (int i = piece->top; i < piece->top + piece->height; ++i) {
+    hit |= rows[i * lanes] & laneRow(piece->rows[i], x);
+  }
+  return hit == 0;
+}
+
+/**
+ * Recomputes the rows of a lane's tetromino after it spawned, moved
+ * sideways or rotated.
+ * @param batch The batch.
+ * @param game Lane of the game.
+ */
+static void placeLane(TetrisBatch* batch, int game) {
+  const PieceMask* piece =
+      &kPieceMasks[batch->type[game]][batch->rotation[game]];
+  for (int i = 0; i < kFigureSize; ++i) {
+    batch->placed[i * batch->lanes + game] =
+        laneRow(piece->rows[i], batch->x[game]);
+  }
+}
+
+/**
+ * Rotates the tetromino of a lane with the wall kicks of rotateTetromino().
+ * @param batch The batch.
+ * @param game Lane of the game.
+ */
+static void rotateLane(TetrisBatch* batch, int game) {
+  int type = batch->type[game];
+  int rotations = getRotationsPerTetromino()[type];
+  if (rotations <= 1) {
+    return;
+  }
+  int rotation = (batch->rotation[game] + 1) % rotations;
+  int offsets[7][2];
+  int numOffsets;
+  getRotationOffsets(type, offsets, &numOffsets);
+  for (int k = 0; k < numOffsets; ++k) {
+    int x = batch->x[game] + offsets[k][0];
+    int y = batch->y[game] + offsets[k][1];
+    if (fitsLane(batch, game, type, rotation, x, y)) {
+      batch->x[game] = (int16_t)x;
+      batch->y[game] = (int16_t)y;
+      batch->rotation[game] = (int8_t)rotation;
+      placeLane(batch, game);
+      return;
+    }
+  }
+}
+
+/**
+ * Moves the tetromino of a lane sideways if it fits, as the first half of
+ * movingTetrominoState(). The fall that completes the move is left to
+ * fallLanes().
+ * @param batch The batch.
+ * @param game Lane of the game.
+ * @param deltaX -1 for left, 1 for right.
+ */
+static void shiftLane(TetrisBatch* batch, int game, int deltaX) {
+  int x = batch->x[game] + deltaX;
+  if (fitsLane(batch, game, batch->type[game], batch->rotation[game], x,
+               batch->y[game])) {
+    batch->x[game] = (int16_t)x;
+    placeLane(batch, game);
+  }
+}
+
+/**
+ * Applies one user action to a lane, as applyUserInput() does. A sideways
+ * move is made at once: the tick that makes it in the scalar engine
+ * always follows the input.
+ * @param batch The batch.
+ * @param game Lane of the game.
+ * @param action The user action.
+ */
+static void applyLaneInput(TetrisBatch* batch, int game, UserAction action) {
+  if (batch->state[game] != kFalling) {
+    return;
+  }
+  int type = batch->type[game];
+  int rotation = batch->rotation[game];
+  int x = batch->x[game];
+  int y = batch->y[game];
+  switch (action) {
+    case kActionLeft:
+    case kActionRight:
+      batch->state[game] = kMoving;
+      shiftLane(batch, game, action == kActionLeft ? -1 : 1);
+      break;
+    case kActionDown:
+      while (fitsLane(batch, game, type, rotation, x, y + 1)) {
+        ++y;
+      }
+      batch->y[game] = (int16_t)y;
+      batch->state[game] = kLocking;
+      break;
+    case kActionRotate:
+      rotateLane(batch, game);
+      break;
+    default:
+      break;
+  }
+}
+
+/**
+ * Runs the gravity step of every lane whose tetromino is falling, as
+ * fallingTetrominoState() and the second half of movingTetrominoState():
+ * the tetromino falls one row if it fits there, otherwise it locks. The
+ * four rows under each tetromino are gathered into a window, then the
+ * probe and the state update run for all lanes of a block at once, as
+ * SIMD over kBatchLanes games. Other lanes are probed too (their y always
+ * stays inside the padded rows), keep their state and are flagged in
+ * batch->pending unless the game is over.
+ * @param batch The batch.
+ * @return Number of games not over.
+ */
+static int fallLanes(TetrisBatch* batch) {
+  int lanes = batch->lanes;
+  int running = 0;
+  for (int block = 0; block < lanes; block += kBatchLanes) {
+    uint16_t window[kFigureSize][kBatchLanes];
+    for (int l = 0; l < kBatchLanes; ++l) {
+      int r = batch->y[block + l] + 1 + kBatchPad;
+      const uint16_t* column = &batch->rows[r * lanes + block + l];
+      for (int i = 0; i < kFigureSize; ++i) {
+        window[i][l] = column[i * lanes];
+      }
+    }
+    // Копии блока не пересекаются друг с другом, и цикл векторизуется.
+    uint8_t state[kBatchLanes];
+    uint8_t pending[kBatchLanes];
+    int16_t y[kBatchLanes];
+    uint16_t placed[kFigureSize][kBatchLanes];
+    memcpy(state, &batch->state[block], sizeof(state));
+    memcpy(y, &batch->y[block], sizeof(y));
+    for (int i = 0; i < kFigureSize; ++i) {
+      memcpy(placed[i], &batch->placed[i * lanes + block], sizeof(placed[i]));
+    }
+    memcpy(&batch->tickState[block], state, sizeof(state));
+    for (int l = 0; l < kBatchLanes; ++l) {
+      uint16_t hit = (uint16_t)((window[0][l] & placed[0][l]) |
+                                (window[1][l] & placed[1][l]) |
+                                (window[2][l] & placed[2][l]) |
+                                (window[3][l] & placed[3][l]));
+      bool falls = state[l] == kFalling || state[l] == kMoving;
+      running += state[l] != kGameOver;
+      pending[l] = !falls && state[l] != kGameOver;
+      y[l] = (int16_t)(y[l] + (falls && !hit));
+      state[l] = falls ? (hit ? kLocking : kFalling) : state[l];
+    }
+    memcpy(&batch->state[block], state, sizeof(state));
+    memcpy(&batch->y[block], y, sizeof(y));
+    memcpy(&batch->pending[block], pending, sizeof(pending));
+  }
+  return running;
+}
+
+/**
+ * Merges the tetromino of a lane into its rows, as lockTetromino().
+ * @param batch The batch.
+ * @param game Lane of the game.
+ */
+static void lockLane(TetrisBatch* batch, int game) {
+  int lanes = batch->lanes;
+  uint16_t* rows = &batch->rows[(batch->y[game] + kBatchPad) * lanes + game];
+  for (int i = 0; i < kFigureSize; ++i) {
+    rows[i * lanes] |= batch->placed[i * lanes + game];
+  }
+}
+
+/**
+ * Counts the full field rows of every lane. Blocks with no lane clearing
+ * lines are skipped and get 0.
+ * @param batch The batch.
+ */
+static void countFullRows(TetrisBatch* batch) {
+  int lanes = batch->lanes;
+  for (int block = 0; block < lanes; block += kBatchLanes) {
+    bool clears = false;
+    for (int l = 0; l < kBatchLanes; ++l) {
+      clears |= batch->tickState[block + l] == kClearing;
+    }
+    uint8_t full[kBatchLanes] = {0};
+    for (int r = kBatchPad; clears && r < kBatchPad + kRow; ++r) {
+      const uint16_t* row = &batch->rows[r * lanes + block];
+      for (int l = 0; l < kBatchLanes; ++l) {
+        full[l] += row[l] == kBatchFullRow;
+      }
+    }
+    memcpy(&batch->full[block], full, sizeof(full));
+  }
+}
+
+/**
+ * Removes the full rows of a lane and scores them, as clearLinesState().
+ * @param batch The batch.
+ * @param game Lane of the game.
+ */
+static void clearLane(TetrisBatch* batch, int game) {
+  int lanes = batch->lanes;
+  uint16_t* rows = &batch->rows[kBatchPad * lanes + game];
+  int write = kRow - 1;
+  for (int read = kRow - 1; read >= 0; --read) {
+    uint16_t row = rows[read * lanes];
+    rows[write * lanes] = row;
+    write -= (row != kBatchFullRow);
+  }
+  for (int y = 0; y <= write; ++y) {
+    rows[y * lanes] = kEmptyLaneRow;
+  }
+  batch->lines[game] += write + 1;
+  scoreLines(write + 1, &batch->score[game], &batch->level[game],
+             &batch->pointsTowardLevel[game]);
+}
+
+/**
+ * Spawns the next tetromino of a lane, as spawnTetrominoState().
+ * @param batch The batch.
+ * @param game Lane of the game.
+ */
+static void spawnLane(TetrisBatch* batch, int game) {
+  if (batch->next[game] == kNoTetromino) {
+    batch->next[game] = (int8_t)dealTetromino(
+        &batch->randomState[game], &batch->bagLeft[game], batch->randomizer);
+  }
+  int type = batch->next[game];
+  const PieceMask* piece = &kPieceMasks[type][0];
+  batch->type[game] = (int8_t)type;
+  batch->rotation[game] = 0;
+  batch->x[game] = piece->spawnX;
+  batch->y[game] = piece->spawnY;
+  if (!fitsLane(batch, game, type, 0, piece->spawnX, piece->spawnY)) {
+    batch->state[game] = kGameOver;
+    return;
+  }
+  placeLane(batch, game);
+  batch->next[game] = (int8_t)dealTetromino(
+      &batch->randomState[game], &batch->bagLeft[game], batch->randomizer);
+  batch->state[game] = kFalling;
+}
+
+int tetris_batchStep(TetrisBatch* batch, const UserAction* actions) {
+  int lanes = batch->lanes;
+  if (actions) {
+    for (int g = 0; g < batch->count; ++g) {
+      applyLaneInput(batch, g, actions[g]);
+    }
+  }
+  // Каждая игра делает один переход автомата из состояния после ввода.
+  // Дополнительные дорожки всегда в kGameOver и не считаются.
+  int running = fallLanes(batch);
+  bool clearing = false;
+  for (int word = 0; word < lanes; word += 8) {
+    // Флаги восьми дорожек читаются одним словом: дорожки без редких
+    // переходов пропускаются разом.
+    uint64_t flags;
+    memcpy(&flags, &batch->pending[word], sizeof(flags));
+    while (flags) {
+      int g = word + __builtin_ctzll(flags) / 8;
+      flags &= flags - 1;
+      switch (batch->tickState[g]) {
+        case kLocking:
+          lockLane(batch, g);
+          batch->state[g] = kClearing;
+          break;
+        case kClearing:
+          clearing = true;
+          batch->state[g] = kSpawn;
+          break;
+        case kSpawn:
+          spawnLane(batch, g);
+          running -= batch->state[g] == kGameOver;
+          break;
+        default:
+          break;
+      }
+    }
+  }
+  if (clearing) {
+    countFullRows(batch);
+    for (int g = 0; g < lanes; ++g) {
+      if (batch->full[g] > 0 && batch->tickState[g] == kClearing) {
+        clearLane(batch, g);
+      }
+    }
+  }
+  return running;
+}
+
+void tetris_batchGame(const TetrisBatch* batch, int game, GameState* gs) {
+  memset(gs, 0, sizeof(GameState));
+  int lanes = batch->lanes;
+  gs->state = (FsmState)batch->state[game];
+  gs->tetrominoX = batch->x[game];
+  gs->tetrominoY = batch->y[game];
+  gs->tetrominoType = batch->type[game];
+  gs->rotationIndex = batch->rotation[game];
+  gs->nextTetrominoType = batch->next[game];
+  gs->pieceActive = gs->state == kFalling || gs->state == kLocking;
+  for (int y = 0; y < kRow; ++y) {
+    uint16_t row = batch->rows[(y + kBatchPad) * lanes + game];
+    gs->board[y] = (uint16_t)((row >> kBatchWall) & kFullRow);
+  }
+  rebuildColumnHeights(gs);
+  gs->boardHash = hashBoard(gs->board);
+  if (gs->pieceActive) {
+    gs->ghostY = landingRow(gs, gs->tetrominoType, gs->rotationIndex,
+                            gs->tetrominoX, gs->tetrominoY);
+  }
+  GameStats* stats = &gs->stats;
+  stats->score = batch->score[game];
+  stats->high_score = batch->score[game];
+  stats->level = batch->level[game];
+  stats->speed = kSpeed - (stats->level - 1) * 100;
+  if (stats->speed < kMinSpeed) {
+    stats->speed = kMinSpeed;
+  }
+  stats->pause = gs->state == kGameOver ? -1 : 0;
+  gs->pointsTowardLevel = batch->pointsTowardLevel[game];
+  gs->linesCleared = batch->lines[game];
+  gs->randomState = batch->randomState[game];
+  gs->randomizer = batch->randomizer;
+  gs->bagLeft = batch->bagLeft[game];
+}
@@ -0,0 +1,94 @@
+#ifndef TETRIS_BATCH_H_
+#define TETRIS_BATCH_H_
+
+#include "tetris.h"
+
+enum {
+  kBatchLanes = 16,                   // Lane count is a multiple of this.
+  kBatchWall = 3,                     // Wall columns left of the field.
+  kBatchPad = 4,                      // Wall rows above and below the field.
+  kBatchRows = kRow + 2 * kBatchPad,  // Rows stored per game.
+  kBatchFullRow = 0xFFFF              // Row with every cell and wall set.
+};
+
+// K games in structure-of-arrays form. Game g lives in lane g of every
+// array, so a loop over lanes touches consecutive memory and the compiler
+// turns it into SIMD over games. Row r of game g is rows[r * lanes + g]:
+// field row y is r = y + kBatchPad, cell (x, y) is bit x + kBatchWall, and
+// the wall bits and the kBatchPad rows above and below the field are
+// always set. Pieces therefore never need bounds checks.
+//
+// A game is played by the same rules as a TetrisGame (tetris_batchStep()
+// is one tetris_userInput() and one tetris_tick()), but only the fields
+// the rules read are kept; tetris_batchGame() rebuilds the rest.
+typedef struct {
+  int count;                   // Games in the batch.
+  int lanes;                   // count rounded up to kBatchLanes.
+  PieceRandomizer randomizer;  // How the next tetromino is picked.
+  uint16_t* rows;              // kBatchRows rows per lane.
+  uint8_t* state;              // FsmState per lane.
+  int16_t* x;                  // X-coordinate of the tetromino.
+  int16_t* y;                  // Y-coordinate of the tetromino.
+  int8_t* type;                // Type of the current tetromino.
+  int8_t* rotation;            // Rotation index.
+  int8_t* next;                // Type of the next tetromino or kNoTetromino.
+  int* score;                  // Current score.
+  int* level;                  // Current level.
+  int* pointsTowardLevel;      // Points toward the next level.
+  int* lines;                  // Lines cleared since the game start.
+  uint64_t* randomState;       // PCG32 state of the piece generator.
+  uint8_t* bagLeft;            // Types left in the 7-bag, bit per type.
+  uint16_t* placed;            // Tetromino grid row i at x: i * lanes + g.
+  // Рабочие массивы шага.
+  uint8_t* tickState;  // State each lane ticks from.
+  uint8_t* pending;    // 1 if the lane locks, clears lines or spawns.
+  uint8_t* full;       // Full rows per lane.
+} TetrisBatch;
+
+/**
+ * Allocates a batch. Lane g starts as tetris_batchReset(batch, g, g) and
+ * padding lanes stay in kGameOver.
+ * @param count Number of games (at least 1).
+ * @param randomizer Piece randomizer of every game.
+ * @return The batch, NULL on invalid count or allocation failure.
+ */
+TetrisBatch* tetris_batchCreate(int count, PieceRandomizer randomizer);
+
+/**
+ * Frees a batch.
+ * @param batch The batch (may be NULL).
+ */
+void tetris_batchDestroy(TetrisBatch* batch);
+
+/**
+ * Starts a new game in a lane, as tetris_seed() followed by kActionStart
+ * on a game that does not persist the high score.
+ * @param batch The batch.
+ * @param game Lane of the game.
+ * @param seed Seed of the piece generator.
+ */
+void tetris_batchReset(TetrisBatch* batch, int game, uint64_t seed);
+
+/**
+ * Advances every game by one step: tetris_userInput() with the game's
+ * action, then tetris_tick(). Left, Right, Down and Rotate are applied;
+ * any other action means no input. The gravity probe and the full row
+ * scan run over all lanes at once; the rarer moves, rotations, hard
+ * drops, locks, line removal and spawns run per game.
+ * @param batch The batch.
+ * @param actions One action per game, or NULL for no input.
+ * @return Number of games not over.
+ */
+int tetris_batchStep(TetrisBatch* batch, const UserAction* actions);
+
+/**
+ * Exports a game as a GameState, e.g. for autoplayChoose() or to compare
+ * with a TetrisGame. The high score equals the score, ghostY is the
+ * landing row of a falling tetromino and moveDirection is not kept.
+ * @param batch The batch.
+ * @param game Lane of the game.
+ * @param gs Pointer to receive the state.
+ */
+void tetris_batchGame(const TetrisBatch* batch, int game, GameState* gs);
+
+#endif
@@ -0,0 +1,65 @@
+#include "board_features.h"
+
+// Row mask with the side walls added as filled cells at bits 0 and
+// kCol + 1; the field occupies bits 1 to kCol.
+enum { kWalls = 1 | 1 << (kCol + 1), kWalledRow = (1 << (kCol + 1)) - 1 };
+
+void extractFeatures(const uint16_t* board, BoardFeatures* features) {
+  memset(features, 0, sizeof(*features));
+  // Пустые строки над стопкой дают по два перехода у стен и ничего больше.
+  int top = 0;
+  while (top < kRow && !board[top]) {
+    ++top;
+  }
+  features->rowTransitions = 2 * top;
+
+  uint16_t holeRows[kRow];
+  unsigned above = 0;
+  unsigned previous = top > 0 ? 0 : board[0];
+  int filled = 0;
+  // Сверху вниз: above накапливает занятые столбцы, поэтому пустая клетка
+  // под ним — дыра, а впервые появившийся бит задаёт высоту столбца.
+  for (int y = top; y < kRow; ++y) {
+    unsigned row = board[y];
+    for (unsigned fresh = row & ~above; fresh; fresh &= fresh - 1) {
+      features->heights[__builtin_ctz(fresh)] = (uint8_t)(kRow - y);
+    }
+    holeRows[y] = (uint16_t)(above & ~row);
+    above |= row;
+    filled += popcount16(row);
+
+    unsigned walled = row << 1 | kWalls;
+    features->rowTransitions +=
+        popcount16((walled ^ walled >> 1) & kWalledRow);
+    features->columnTransitions += popcount16(previous ^ row);
+    previous = row;
+  }
+  features->columnTransitions += popcount16(previous ^ kFullRow);
+  // Снизу вверх: holeBelow — столбцы, где ниже текущей строки есть дыра.
+  unsigned holeBelow = 0;
+  for (int y = kRow - 1; y >= top; --y) {
+    features->coveredCells += popcount16(board[y] & holeBelow);
+    holeBelow |= holeRows[y];
+  }
+
+  const uint8_t* heights = features->heights;
+  for (int x = 0; x < kCol; ++x) {
+    int height = heights[x];
+    int left = x > 0 ? heights[x - 1] : kRow;
+    int right = x < kCol - 1 ? heights[x + 1] : kRow;
+    int depth = (left < right ? left : right) - height;
+    if (depth > 0) {
+      features->wellDepths[x] = (uint8_t)depth;
+      features->cumulativeWells += depth * (depth + 1) / 2;
+    }
+    if (x < kCol - 1) {
+      features->bumpiness += abs(height - right);
+    }
+    if (height > features->maxHeight) {
+      features->maxHeight = height;
+    }
+    features->aggregateHeight += height;
+  }
+  // Каждый столбец высоты h содержит h клеток, пустые среди них — дыры.
+  features->holes = features->aggregateHeight - filled;
+}
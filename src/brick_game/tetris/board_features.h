@@ -0,0 +1,29 @@
+#ifndef TETRIS_BOARD_FEATURES_H_
+#define TETRIS_BOARD_FEATURES_H_
+
+#include "tetris.h"
+
+// Board features used by placement evaluators. Heights count from the
+// floor, so an empty column has height 0 and a full one kRow.
+typedef struct {
+  uint8_t heights[kCol];     // Height of each column.
+  uint8_t wellDepths[kCol];  // Depth below both neighbours (walls: kRow).
+  int maxHeight;             // Height of the tallest column.
+  int aggregateHeight;       // Sum of the column heights.
+  int holes;                 // Empty cells with a filled cell above.
+  int coveredCells;          // Filled cells with a hole below.
+  int bumpiness;             // Sum of height steps between neighbours.
+  int rowTransitions;        // Filled/empty changes along rows, walls full.
+  int columnTransitions;     // Filled/empty changes down columns, floor full.
+  int cumulativeWells;       // Sum of 1 + 2 + ... + depth over all wells.
+} BoardFeatures;
+
+/**
+ * Extracts the features of a bitboard in one pass over its rows using
+ * popcount, ctz and mask arithmetic on the packed rows.
+ * @param board Board rows, bit x of row y is (x, y) (kRow entries).
+ * @param features Pointer to receive the features.
+ */
+void extractFeatures(const uint16_t* board, BoardFeatures* features);
+
+#endif
@@ -0,0 +1,109 @@
+#include "placement.h"
+
+// BFS frontier and visited set of one search.
+typedef struct {
+  uint16_t visited[4][kPlacementYSlots];  // Bit x + kFigureSize per row.
+  Placement queue[kMaxPlacements];        // Positions in discovery order.
+  int tail;                               // Positions queued.
+} PlacementSearch;
+
+/**
+ * Queues a piece position unless it was seen before.
+ * @param search The search.
+ * @param x X-coordinate; the piece must fit there.
+ * @param y Y-coordinate.
+ * @param rotation Rotation index.
+ */
+static void visit(PlacementSearch* search, int x, int y, int rotation) {
+  uint16_t* row = &search->visited[rotation][y + kFigureSize];
+  uint16_t bit = (uint16_t)(1u << (x + kFigureSize));
+  if (!(*row & bit)) {
+    *row |= bit;
+    search->queue[search->tail++] =
+        (Placement){(int16_t)x, (int16_t)y, (uint8_t)rotation};
+  }
+}
+
+int enumeratePlacements(const GameState* gs, int type, int rotation, int x,
+                        int y, Placement* placements) {
+  if (!fits(gs, type, rotation, x, y)) {
+    return 0;
+  }
+  int numRotations = getRotationsPerTetromino()[type];
+  int offsets[7][2];
+  int numOffsets;
+  getRotationOffsets(type, offsets, &numOffsets);
+
+  PlacementSearch search;
+  memset(search.visited, 0, sizeof(search.visited));
+  search.tail = 0;
+  visit(&search, x, y, rotation);
+  int count = 0;
+  for (int head = 0; head < search.tail; ++head) {
+    Placement at = search.queue[head];
+    if (fits(gs, type, at.rotation, at.x, at.y + 1)) {
+      visit(&search, at.x, at.y + 1, at.rotation);
+    } else {
+      placements[count++] = at;
+    }
+    for (int deltaX = -1; deltaX <= 1; deltaX += 2) {
+      if (fits(gs, type, at.rotation, at.x + deltaX, at.y)) {
+        visit(&search, at.x + deltaX, at.y, at.rotation);
+      }
+    }
+    if (numRotations > 1) {
+      // Как в rotateTetromino(): применяется первое подходящее смещение.
+      int nextRotation = (at.rotation + 1) % numRotations;
+      for (int k = 0; k < numOffsets; ++k) {
+        int newX = at.x + offsets[k][0];
+        int newY = at.y + offsets[k][1];
+        if (fits(gs, type, nextRotation, newX, newY)) {
+          visit(&search, newX, newY, nextRotation);
+          break;
+        }
+      }
+    }
+  }
+  return count;
+}
+
+int tetris_placements(const TetrisGame* game, Placement* placements) {
+  const GameState* gs = &game->state;
+  if (!gs->pieceActive) {
+    return 0;
+  }
+  return enumeratePlacements(gs, gs->tetrominoType, gs->rotationIndex,
+                             gs->tetrominoX, gs->tetrominoY, placements);
+}
+
+void applyPlacement(GameState* gs, int type, const Placement* placement) {
+  gs->tetrominoType = type;
+  gs->rotationIndex = placement->rotation;
+  gs->tetrominoX = placement->x;
+  gs->tetrominoY = placement->y;
+  gs->pieceActive = true;
+  lockTetromino(gs);
+  FsmState state;
+  clearLinesState(gs, &state);
+}
+
+uint64_t perft(const GameState* gs, const int* pieces, int depth) {
+  if (depth == 0) {
+    return 1;
+  }
+  Placement placements[kMaxPlacements];
+  const PieceMask* spawn = &kPieceMasks[pieces[0]][0];
+  int count = enumeratePlacements(gs, pieces[0], 0, spawn->spawnX,
+                                  spawn->spawnY, placements);
+  // Последний уровень считается без применения размещений.
+  if (depth == 1) {
+    return (uint64_t)count;
+  }
+  uint64_t leaves = 0;
+  for (int i = 0; i < count; ++i) {
+    GameState child = *gs;
+    applyPlacement(&child, pieces[0], &placements[i]);
+    leaves += perft(&child, pieces + 1, depth - 1);
+  }
+  return leaves;
+}
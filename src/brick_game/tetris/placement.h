@@ -0,0 +1,70 @@
+#ifndef TETRIS_PLACEMENT_H_
+#define TETRIS_PLACEMENT_H_
+
+#include "tetris.h"
+
+// Bounds of the placement search. A piece position (x, y) is kept while
+// its grid overlaps the field, so x and y range from -kFigureSize + 1 to
+// kCol - 1 and kRow - 1.
+enum {
+  kPlacementXSlots = kCol + kFigureSize,  // Distinct x-coordinates.
+  kPlacementYSlots = kRow + kFigureSize,  // Distinct y-coordinates.
+  kMaxPlacements = 4 * kPlacementXSlots * kPlacementYSlots  // Upper bound.
+};
+
+// Final resting position of a tetromino.
+typedef struct {
+  int16_t x;         // X-coordinate of the tetromino's top-left corner.
+  int16_t y;         // Landing row of the tetromino's top-left corner.
+  uint8_t rotation;  // Rotation index.
+} Placement;
+
+/**
+ * Enumerates every distinct final placement a tetromino can reach from a
+ * start position. The search is a BFS over (x, rotation, y) with a
+ * visited bitset and follows the engine's move rules: sideways shifts as
+ * in movingTetrominoState(), rotations with the getRotationOffsets() kicks
+ * as in rotateTetromino(), and one-row gravity steps as in
+ * fallingTetrominoState(). Any number of inputs may come between two
+ * gravity steps, as with tetris_userInputBatch(). A position is final
+ * when the piece cannot fall from it; a hard drop lands on one of these.
+ * @param gs Pointer to the game state (only the board is read).
+ * @param type Type of tetromino (0–6 for I, L, O, T, S, Z, J).
+ * @param rotation Start rotation index.
+ * @param x Start x-coordinate.
+ * @param y Start y-coordinate.
+ * @param placements Array to receive the placements (kMaxPlacements).
+ * @return Number of placements, 0 if the start position does not fit.
+ */
+int enumeratePlacements(const GameState* gs, int type, int rotation, int x,
+                        int y, Placement* placements);
+
+/**
+ * Enumerates the placements of the falling tetromino of a game instance.
+ * @param game The game instance.
+ * @param placements Array to receive the placements (kMaxPlacements).
+ * @return Number of placements, 0 if no tetromino is falling.
+ */
+int tetris_placements(const TetrisGame* game, Placement* placements);
+
+/**
+ * Locks a tetromino at a placement and clears the completed lines. Score,
+ * level and line count are updated as in the game.
+ * @param gs Pointer to the game state.
+ * @param type Type of tetromino (0–6 for I, L, O, T, S, Z, J).
+ * @param placement The placement.
+ */
+void applyPlacement(GameState* gs, int type, const Placement* placement);
+
+/**
+ * Counts the leaves of the placement tree: every sequence of placements
+ * of the given pieces, each spawned at its spawn position, to the given
+ * depth.
+ * @param gs Pointer to the game state holding the start board.
+ * @param pieces Tetromino types to place, one per level (depth entries).
+ * @param depth Number of pieces to place.
+ * @return Number of leaf positions.
+ */
+uint64_t perft(const GameState* gs, const int* pieces, int depth);
+
+#endif
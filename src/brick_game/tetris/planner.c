@@ -0,0 +1,330 @@
+#include "planner.h"
+
+#include <stdatomic.h>
+
+const PlannerConfig kDefaultPlannerConfig = {.weights = &kDefaultEvalWeights,
+                                             .beamWidth = 128,
+                                             .preview = 0,
+                                             .threads = 1,
+                                             .budgetMs = 40,
+                                             .cacheBits = 18};
+
+// Position of the search: the board after some placements.
+typedef struct {
+  GameState state;     // State after the placements.
+  double pathScore;    // Landing height and line terms of the placements.
+  double score;        // pathScore plus the evaluation of the board.
+  AutoplayPlan first;  // Plan of the falling tetromino leading here.
+} PlanNode;
+
+// Entry of the ranking of a level's positions.
+typedef struct {
+  double score;  // Score of the position.
+  int index;     // Index of the position in BeamPlanner.children.
+} RankedNode;
+
+// Per-worker counters, one cache line each.
+typedef struct {
+  _Alignas(64) long expanded;  // Positions expanded.
+  long children;               // Positions generated.
+  long cacheHits;              // Evaluations found in the cache.
+} WorkerCounters;
+
+struct BeamPlanner {
+  PlannerConfig config;      // Settings.
+  WorkPool* pool;            // Workers.
+  WorkerCounters* counters;  // One per worker.
+  PlanNode* beam;            // Positions kept (beamWidth).
+  PlanNode* children;        // kMaxAutoplayPlans slots per kept position.
+  int* childCounts;          // Positions generated per kept position.
+  RankedNode* ranks;         // Distinct positions of a level.
+  int* table;                // Open-addressing index into ranks, -1 free.
+  int tableMask;             // Table size minus one.
+  TranspositionTable cache;  // Board evaluations by board hash.
+  // Поля текущего уровня, общие для заданий.
+  int level;                           // Index of the searched tetromino.
+  int pieces[2 + kMaxPlannerPreview];  // Tetrominoes by level.
+  struct timespec deadline;            // End of the time budget.
+  atomic_bool expired;                 // The budget ran out.
+};
+
+static double millisecondsSince(const struct timespec* start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)(now.tv_sec - start->tv_sec) * 1e3 +
+         (double)(now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static bool pastDeadline(const struct timespec* deadline) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec > deadline->tv_sec ||
+         (now.tv_sec == deadline->tv_sec && now.tv_nsec >= deadline->tv_nsec);
+}
+
+BeamPlanner* plannerCreate(const PlannerConfig* config) {
+  BeamPlanner* planner = calloc(1, sizeof(BeamPlanner));
+  if (!planner) {
+    fprintf(stderr, "Failed to allocate planner\n");
+    return NULL;
+  }
+  planner->config = *config;
+  PlannerConfig* settings = &planner->config;
+  if (settings->beamWidth < 1) {
+    settings->beamWidth = 1;
+  }
+  if (settings->preview < 0) {
+    settings->preview = 0;
+  } else if (settings->preview > kMaxPlannerPreview) {
+    settings->preview = kMaxPlannerPreview;
+  }
+  int slots = settings->beamWidth * kMaxAutoplayPlans;
+  int tableSize = 1;
+  while (tableSize < 2 * slots) {
+    tableSize *= 2;
+  }
+  planner->tableMask = tableSize - 1;
+  planner->pool = workPoolCreate(settings->threads);
+  planner->beam = malloc(settings->beamWidth * sizeof(PlanNode));
+  planner->children = malloc(slots * sizeof(PlanNode));
+  planner->childCounts = malloc(settings->beamWidth * sizeof(int));
+  planner->ranks = malloc(slots * sizeof(RankedNode));
+  planner->table = malloc(tableSize * sizeof(int));
+  bool cacheFailed = settings->cacheBits > 0 &&
+                     ttCreate(&planner->cache, settings->cacheBits) != 0;
+  if (planner->pool) {
+    planner->counters = aligned_alloc(
+        _Alignof(WorkerCounters),
+        workPoolThreads(planner->pool) * sizeof(WorkerCounters));
+  }
+  if (!planner->pool || !planner->counters || !planner->beam ||
+      !planner->children || !planner->childCounts || !planner->ranks ||
+      !planner->table || cacheFailed) {
+    fprintf(stderr, "Failed to allocate planner\n");
+    plannerDestroy(planner);
+    return NULL;
+  }
+  return planner;
+}
+
+void plannerDestroy(BeamPlanner* planner) {
+  if (!planner) {
+    return;
+  }
+  workPoolDestroy(planner->pool);
+  free(planner->counters);
+  free(planner->beam);
+  free(planner->children);
+  free(planner->childCounts);
+  free(planner->ranks);
+  free(planner->table);
+  ttDestroy(&planner->cache);
+  free(planner);
+}
+
+/**
+ * Evaluates a board through the cache.
+ * @param planner The planner.
+ * @param gs Pointer to the game state.
+ * @param worker Worker number, for the hit counter.
+ * @return The weighted board features.
+ */
+static double evaluateCached(BeamPlanner* planner, const GameState* gs,
+                             int worker) {
+  uint64_t bits;
+  double score;
+  if (!planner->cache.entries) {
+    return autoplayEvaluate(gs, planner->config.weights);
+  }
+  if (ttProbe(&planner->cache, gs->boardHash, &bits)) {
+    planner->counters[worker].cacheHits++;
+    memcpy(&score, &bits, sizeof(score));
+    return score;
+  }
+  score = autoplayEvaluate(gs, planner->config.weights);
+  memcpy(&bits, &score, sizeof(bits));
+  ttStore(&planner->cache, gs->boardHash, bits);
+  return score;
+}
+
+/**
+ * Expands one kept position with every plan of the level's tetromino.
+ * Children go to the position's own slots, so their order does not depend
+ * on which worker ran the job.
+ * @param index Index of the position in the beam.
+ * @param worker Worker number.
+ * @param context The planner.
+ */
+static void expandNode(int index, int worker, void* context) {
+  BeamPlanner* planner = context;
+  int* count = &planner->childCounts[index];
+  *count = 0;
+  if (planner->level > 0 &&
+      (atomic_load_explicit(&planner->expired, memory_order_relaxed) ||
+       pastDeadline(&planner->deadline))) {
+    atomic_store_explicit(&planner->expired, true, memory_order_relaxed);
+    return;
+  }
+  const EvalWeights* weights = planner->config.weights;
+  const PlanNode* node = &planner->beam[index];
+  GameState start = node->state;
+  int type = planner->pieces[planner->level];
+  if (planner->level > 0) {
+    const PieceMask* spawn = &kPieceMasks[type][0];
+    // Следующая фигура не помещается: позиция ведёт к концу игры.
+    if (!fits(&start, type, 0, spawn->spawnX, spawn->spawnY)) {
+      return;
+    }
+    spawnTetromino(&start, spawn->spawnX, spawn->spawnY, type, 0);
+  }
+  PlanNode* children = &planner->children[index * kMaxAutoplayPlans];
+  int rotations = getRotationsPerTetromino()[type];
+  for (int r = 0; r < rotations; ++r) {
+    for (int shift = -kCol; shift <= kCol; ++shift) {
+      AutoplayPlan plan = {r, shift};
+      PlanNode* child = &children[*count];
+      child->state = start;
+      double landingHeight;
+      int rowsCleared;
+      if (!autoplayApply(&child->state, &plan, &landingHeight,
+                         &rowsCleared)) {
+        continue;
+      }
+      child->pathScore = node->pathScore +
+                         weights->landingHeight * landingHeight +
+                         weights->rowsCleared * rowsCleared;
+      child->score =
+          child->pathScore + evaluateCached(planner, &child->state, worker);
+      child->first = planner->level == 0 ? plan : node->first;
+      ++*count;
+    }
+  }
+  planner->counters[worker].expanded++;
+  planner->counters[worker].children += *count;
+}
+
+static int compareRanks(const void* a, const void* b) {
+  const RankedNode* x = a;
+  const RankedNode* y = b;
+  if (x->score != y->score) {
+    return x->score < y->score ? 1 : -1;
+  }
+  return (x->index > y->index) - (x->index < y->index);
+}
+
+/**
+ * Merges the children of a level into the beam: positions with the same
+ * board collapse into the best-scoring one, and the beamWidth best are
+ * kept, best first.
+ * @param planner The planner.
+ * @param parents Number of positions expanded.
+ * @param duplicates Pointer to the duplicate counter.
+ * @return Number of positions kept.
+ */
+static int mergeChildren(BeamPlanner* planner, int parents,
+                         long* duplicates) {
+  memset(planner->table, -1, (planner->tableMask + 1) * sizeof(int));
+  int distinct = 0;
+  for (int parent = 0; parent < parents; ++parent) {
+    for (int c = 0; c < planner->childCounts[parent]; ++c) {
+      int index = parent * kMaxAutoplayPlans + c;
+      const PlanNode* child = &planner->children[index];
+      uint64_t hash = child->state.boardHash;
+      int slot = (int)(hash & (uint64_t)planner->tableMask);
+      int rank;
+      while ((rank = planner->table[slot]) >= 0) {
+        const PlanNode* other = &planner->children[planner->ranks[rank].index];
+        if (other->state.boardHash == hash &&
+            memcmp(other->state.board, child->state.board,
+                   sizeof(child->state.board)) == 0) {
+          break;
+        }
+        slot = (slot + 1) & planner->tableMask;
+      }
+      if (rank < 0) {
+        planner->table[slot] = distinct;
+        planner->ranks[distinct++] = (RankedNode){child->score, index};
+      } else {
+        ++*duplicates;
+        if (child->score > planner->ranks[rank].score) {
+          planner->ranks[rank] = (RankedNode){child->score, index};
+        }
+      }
+    }
+  }
+  qsort(planner->ranks, distinct, sizeof(RankedNode), compareRanks);
+  int kept = distinct < planner->config.beamWidth ? distinct
+                                                  : planner->config.beamWidth;
+  for (int i = 0; i < kept; ++i) {
+    planner->beam[i] = planner->children[planner->ranks[i].index];
+  }
+  return kept;
+}
+
+bool plannerChoose(BeamPlanner* planner, const GameState* gs,
+                   AutoplayPlan* plan, PlannerStats* stats) {
+  if (!gs->pieceActive) {
+    return false;
+  }
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  struct timespec* deadline = &planner->deadline;
+  int budgetMs = planner->config.budgetMs;
+  *deadline = start;
+  deadline->tv_sec += budgetMs / 1000;
+  deadline->tv_nsec += (long)(budgetMs % 1000) * 1000000L;
+  if (deadline->tv_nsec >= 1000000000L) {
+    deadline->tv_sec++;
+    deadline->tv_nsec -= 1000000000L;
+  }
+  atomic_store(&planner->expired, false);
+
+  // Превью раздаётся с копии генератора фигур.
+  int levels = 1;
+  planner->pieces[0] = gs->tetrominoType;
+  if (gs->nextTetrominoType != kNoTetromino) {
+    planner->pieces[levels++] = gs->nextTetrominoType;
+    GameState dealer = *gs;
+    for (int i = 0; i < planner->config.preview; ++i) {
+      int rotation;
+      generateNextTetromino(&dealer, &planner->pieces[levels++], &rotation);
+    }
+  }
+  int threads = workPoolThreads(planner->pool);
+  memset(planner->counters, 0, threads * sizeof(WorkerCounters));
+
+  PlannerStats result = {0};
+  planner->beam[0] = (PlanNode){.state = *gs};
+  int kept = 1;
+  for (int level = 0; level < levels; ++level) {
+    planner->level = level;
+    workPoolRun(planner->pool, kept, expandNode, planner);
+    if (atomic_load(&planner->expired)) {
+      result.timedOut = true;
+      break;
+    }
+    long duplicates = 0;
+    int merged = mergeChildren(planner, kept, &duplicates);
+    result.duplicates += duplicates;
+    // Все позиции уровня проигрывают: решает предыдущий уровень.
+    if (merged == 0) {
+      break;
+    }
+    kept = merged;
+    *plan = planner->beam[0].first;
+    result.depth = level + 1;
+  }
+  if (result.depth == 0) {
+    *plan = (AutoplayPlan){0, 0};
+  }
+  for (int i = 0; i < threads; ++i) {
+    result.expanded += planner->counters[i].expanded;
+    result.children += planner->counters[i].children;
+    result.cacheHits += planner->counters[i].cacheHits;
+  }
+  result.ms = millisecondsSince(&start);
+  if (stats) {
+    *stats = result;
+  }
+  return true;
+}
@@ -0,0 +1,74 @@
+#ifndef TETRIS_PLANNER_H_
+#define TETRIS_PLANNER_H_
+
+#include "autoplay.h"
+#include "transposition.h"
+#include "work_pool.h"
+
+// Longest preview queue the planner looks at beyond the next tetromino.
+enum { kMaxPlannerPreview = 6 };
+
+// Beam search settings.
+typedef struct {
+  const EvalWeights* weights;  // Evaluator weights.
+  int beamWidth;               // Positions kept per searched tetromino.
+  int preview;                 // Tetrominoes searched after the next one.
+  int threads;                 // Workers, the calling thread included.
+  int budgetMs;                // Time budget per decision.
+  int cacheBits;               // Log2 of evaluation cache slots, 0 for none.
+} PlannerConfig;
+
+// Default settings: beam of 128, no extra preview, one worker, 40 ms and a
+// cache of 2^18 evaluations.
+extern const PlannerConfig kDefaultPlannerConfig;
+
+// Statistics of the last decision.
+typedef struct {
+  int depth;        // Tetrominoes searched to completion.
+  long expanded;    // Positions expanded.
+  long children;    // Positions generated.
+  long duplicates;  // Positions dropped as repeats of a board.
+  long cacheHits;   // Evaluations found in the cache.
+  bool timedOut;    // The budget ran out before the last tetromino.
+  double ms;        // Time spent.
+} PlannerStats;
+
+typedef struct BeamPlanner BeamPlanner;
+
+/**
+ * Creates a planner with its own work pool and evaluation cache. The cache
+ * is a transposition table from GameState.boardHash to the board's
+ * evaluation, shared by the workers and kept across decisions: boards
+ * reached by other move orders, and the deeper levels of the previous
+ * decision, are not evaluated again.
+ * @param config Settings (copied).
+ * @return The planner, NULL on allocation failure.
+ */
+BeamPlanner* plannerCreate(const PlannerConfig* config);
+
+/**
+ * Frees a planner and stops its workers.
+ * @param planner The planner (may be NULL).
+ */
+void plannerDestroy(BeamPlanner* planner);
+
+/**
+ * Picks a plan for the falling tetromino with a beam search over the
+ * falling tetromino, the next one and config.preview more dealt from a
+ * copy of the piece generator. Each level expands the kept positions in
+ * parallel with every plan of its tetromino, merges positions that leave
+ * the same board (keeping the best score) and keeps the beamWidth best.
+ * A position scores the landing height and line terms of its placements
+ * plus the evaluation of its board. If the time budget runs out during a
+ * level, the deepest finished level decides; the first level always
+ * finishes.
+ * @param planner The planner.
+ * @param gs Pointer to the game state with a falling tetromino.
+ * @param plan Pointer to receive the plan.
+ * @param stats Pointer to receive the statistics (may be NULL).
+ * @return False if no tetromino is falling.
+ */
+bool plannerChoose(BeamPlanner* planner, const GameState* gs,
+                   AutoplayPlan* plan, PlannerStats* stats);
+
+#endif
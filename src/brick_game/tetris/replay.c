@@ -0,0 +1,557 @@
+#include "replay.h"
+
+static const uint8_t kReplayMagic[4] = {'T', 'T', 'R', 'P'};
+static const uint8_t kIndexMagic[4] = {'T', 'T', 'R', 'I'};
+
+// Outcome of playing records with playRecords().
+enum {
+  kPlayMalformed = -1,  // The log is truncated or corrupt.
+  kPlayLimit,           // The tick limit was reached.
+  kPlayEnd              // The kReplayEnd record was read.
+};
+
+// Decoder position inside a log.
+typedef struct {
+  const uint8_t* data;  // The log.
+  size_t size;          // The log size in bytes.
+  size_t pos;           // Offset of the next record.
+  uint64_t tick;        // Ticks simulated so far.
+} ReplayCursor;
+
+/**
+ * Makes room for more bytes in the recorder buffer.
+ * @param recorder The recorder.
+ * @param extra Number of bytes about to be appended.
+ * @return True if the bytes fit.
+ */
+static bool reserveBytes(TetrisRecorder* recorder, size_t extra) {
+  if (recorder->failed) {
+    return false;
+  }
+  if (recorder->size + extra > recorder->capacity) {
+    size_t capacity = recorder->capacity ? recorder->capacity * 2 : 256;
+    while (capacity < recorder->size + extra) {
+      capacity *= 2;
+    }
+    uint8_t* data = realloc(recorder->data, capacity);
+    if (!data) {
+      fprintf(stderr, "Failed to grow replay buffer\n");
+      recorder->failed = true;
+      return false;
+    }
+    recorder->data = data;
+    recorder->capacity = capacity;
+  }
+  return true;
+}
+
+/**
+ * Appends an unsigned LEB128 varint.
+ * @param recorder The recorder.
+ * @param value The value to append.
+ */
+static void writeVarint(TetrisRecorder* recorder, uint64_t value) {
+  if (reserveBytes(recorder, 10)) {
+    while (value >= 0x80) {
+      recorder->data[recorder->size++] = (uint8_t)(value | 0x80);
+      value >>= 7;
+    }
+    recorder->data[recorder->size++] = (uint8_t)value;
+  }
+}
+
+/**
+ * Appends one record carrying the pending ticks.
+ * @param recorder The recorder.
+ * @param code Action code and flags (kReplayFlagBits bits).
+ */
+static void writeRecord(TetrisRecorder* recorder, unsigned code) {
+  writeVarint(recorder, recorder->pendingTicks << kReplayFlagBits | code);
+  recorder->pendingTicks = 0;
+}
+
+/**
+ * Reads an unsigned LEB128 varint.
+ * @param data The log.
+ * @param size The log size in bytes.
+ * @param pos Pointer to the read position, advanced past the varint.
+ * @param value Pointer to receive the value.
+ * @return True on success, false if the varint is truncated or too long.
+ */
+static bool readVarint(const uint8_t* data, size_t size, size_t* pos,
+                       uint64_t* value) {
+  uint64_t result = 0;
+  for (int shift = 0; shift < 64 && *pos < size; shift += 7) {
+    uint8_t byte = data[(*pos)++];
+    result |= (uint64_t)(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      *value = result;
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Stores an integer as little-endian bytes.
+ * @param bytes Destination.
+ * @param value The value; only the low count bytes are stored.
+ * @param count Number of bytes.
+ */
+static void putLittleEndian(uint8_t* bytes, uint64_t value, int count) {
+  for (int i = 0; i < count; ++i) {
+    bytes[i] = (uint8_t)(value >> (8 * i));
+  }
+}
+
+/**
+ * Loads a little-endian integer.
+ * @param bytes Source.
+ * @param count Number of bytes.
+ * @return The value.
+ */
+static uint64_t getLittleEndian(const uint8_t* bytes, int count) {
+  uint64_t value = 0;
+  for (int i = 0; i < count; ++i) {
+    value |= (uint64_t)bytes[i] << (8 * i);
+  }
+  return value;
+}
+
+/**
+ * Encodes a game state as a keyframe (layout in replay.h).
+ * @param bytes Destination (kReplayKeyframeSize bytes).
+ * @param gs The game state.
+ */
+static void encodeKeyframe(uint8_t* bytes, const GameState* gs) {
+  const GameStats* stats = &gs->stats;
+  // x, y и ghostY занимают по 2 байта, остальные поля по 4.
+  const int fields[] = {gs->tetrominoX,    gs->tetrominoY,
+                        gs->ghostY,        stats->score,
+                        stats->high_score, stats->level,
+                        stats->speed,      stats->pause,
+                        gs->pointsTowardLevel, gs->linesCleared};
+  bytes[0] = (uint8_t)gs->state;
+  bytes[1] = (uint8_t)gs->tetrominoType;
+  bytes[2] = (uint8_t)gs->nextTetrominoType;
+  bytes[3] = (uint8_t)gs->rotationIndex;
+  bytes[4] = (uint8_t)gs->moveDirection;
+  bytes[5] = gs->pieceActive;
+  bytes[6] = (uint8_t)gs->randomizer;
+  bytes[7] = gs->bagLeft;
+  uint8_t* next = bytes + 8;
+  for (int i = 0; i < 10; ++i) {
+    int width = i < 3 ? 2 : 4;
+    putLittleEndian(next, (uint64_t)(int64_t)fields[i], width);
+    next += width;
+  }
+  putLittleEndian(next, gs->randomState, 8);
+  next += 8;
+  for (int y = 0; y < kRow; ++y) {
+    putLittleEndian(next + 2 * y, gs->board[y], 2);
+  }
+}
+
+/**
+ * Decodes a keyframe. Every field is range-checked before the state is
+ * replaced, because the bytes come from a file. The decoded state never
+ * persists the high score.
+ * @param bytes Source (kReplayKeyframeSize bytes).
+ * @param gs Pointer to the game state, left unchanged on failure.
+ * @return True if the keyframe is a valid state.
+ */
+static bool decodeKeyframe(const uint8_t* bytes, GameState* gs) {
+  GameState decoded = {0};
+  GameStats* stats = &decoded.stats;
+  int* fields[] = {&decoded.tetrominoX,    &decoded.tetrominoY,
+                   &decoded.ghostY,        &stats->score,
+                   &stats->high_score,     &stats->level,
+                   &stats->speed,          &stats->pause,
+                   &decoded.pointsTowardLevel, &decoded.linesCleared};
+  decoded.state = (FsmState)bytes[0];
+  decoded.tetrominoType = bytes[1];
+  decoded.nextTetrominoType = bytes[2] == 0xFF ? kNoTetromino : bytes[2];
+  decoded.rotationIndex = bytes[3];
+  decoded.moveDirection = (UserAction)bytes[4];
+  decoded.pieceActive = bytes[5] != 0;
+  decoded.randomizer = (PieceRandomizer)bytes[6];
+  decoded.bagLeft = bytes[7];
+  const uint8_t* next = bytes + 8;
+  for (int i = 0; i < 10; ++i) {
+    int width = i < 3 ? 2 : 4;
+    uint64_t value = getLittleEndian(next, width);
+    *fields[i] = width == 2 ? (int16_t)value : (int32_t)value;
+    next += width;
+  }
+  decoded.randomState = getLittleEndian(next, 8);
+  next += 8;
+  bool valid = bytes[0] <= kGameOver && bytes[1] < kTetrominoTypes &&
+               (bytes[2] < kTetrominoTypes || bytes[2] == 0xFF) &&
+               bytes[4] <= kActionRotate && bytes[5] <= 1 &&
+               bytes[6] <= kRandomizerBag &&
+               bytes[7] < 1u << kTetrominoTypes;
+  valid = valid &&
+          decoded.rotationIndex <
+              getRotationsPerTetromino()[decoded.tetrominoType] &&
+          stats->score >= 0 && stats->high_score >= 0 &&
+          stats->level >= 1 && stats->level <= kMaxLevel &&
+          stats->speed >= kMinSpeed && stats->speed <= kSpeed &&
+          stats->pause >= -1 && stats->pause <= 1 &&
+          decoded.pointsTowardLevel >= 0 && decoded.linesCleared >= 0;
+  for (int y = 0; y < kRow; ++y) {
+    decoded.board[y] = (uint16_t)getLittleEndian(next + 2 * y, 2);
+    valid = valid && decoded.board[y] <= kFullRow;
+  }
+  if (valid) {
+    rebuildColumnHeights(&decoded);
+    decoded.boardHash = hashBoard(decoded.board);
+  }
+  // Активная фигура должна стоять на свободных клетках поля, а тень под
+  // ней: иначе отрисовка и сброс вышли бы за пределы поля.
+  valid = valid &&
+          (!decoded.pieceActive ||
+           (fits(&decoded, decoded.tetrominoType, decoded.rotationIndex,
+                 decoded.tetrominoX, decoded.tetrominoY) &&
+            decoded.ghostY ==
+                landingRow(&decoded, decoded.tetrominoType,
+                           decoded.rotationIndex, decoded.tetrominoX,
+                           decoded.tetrominoY)));
+  if (valid) {
+    *gs = decoded;
+  }
+  return valid;
+}
+
+/**
+ * Appends a keyframe holding the game state and adds it to the index.
+ * @param recorder The recorder.
+ * @param gs The game state.
+ */
+static void writeKeyframe(TetrisRecorder* recorder, const GameState* gs) {
+  if (recorder->keyframeCount == recorder->keyframeCapacity &&
+      !recorder->failed) {
+    size_t capacity =
+        recorder->keyframeCapacity ? recorder->keyframeCapacity * 2 : 16;
+    ReplayKeyframe* keyframes =
+        realloc(recorder->keyframes, capacity * sizeof(ReplayKeyframe));
+    if (!keyframes) {
+      fprintf(stderr, "Failed to grow replay index\n");
+      recorder->failed = true;
+    } else {
+      recorder->keyframes = keyframes;
+      recorder->keyframeCapacity = capacity;
+    }
+  }
+  writeRecord(recorder, kReplayControl);
+  writeVarint(recorder, kReplayKeyframe);
+  writeVarint(recorder, kReplayKeyframeSize);
+  if (reserveBytes(recorder, kReplayKeyframeSize)) {
+    ReplayKeyframe* keyframe = &recorder->keyframes[recorder->keyframeCount++];
+    keyframe->tick = recorder->ticks;
+    keyframe->offset = recorder->size;
+    encodeKeyframe(recorder->data + recorder->size, gs);
+    recorder->size += kReplayKeyframeSize;
+  }
+}
+
+/**
+ * Appends the keyframe index and the trailer pointing at it.
+ * @param recorder The recorder.
+ */
+static void writeIndex(TetrisRecorder* recorder) {
+  size_t indexOffset = recorder->size;
+  writeVarint(recorder, recorder->keyframeCount);
+  uint64_t previous = 0;
+  for (size_t i = 0; i < recorder->keyframeCount; ++i) {
+    writeVarint(recorder, recorder->keyframes[i].tick - previous);
+    writeVarint(recorder, recorder->keyframes[i].offset);
+    previous = recorder->keyframes[i].tick;
+  }
+  if (indexOffset > UINT32_MAX) {
+    recorder->failed = true;
+  }
+  if (reserveBytes(recorder, kReplayTrailerSize)) {
+    uint8_t* trailer = recorder->data + recorder->size;
+    for (int i = 0; i < 4; ++i) {
+      trailer[i] = (uint8_t)(indexOffset >> (8 * i));
+    }
+    memcpy(trailer + 4, kIndexMagic, sizeof(kIndexMagic));
+    recorder->size += kReplayTrailerSize;
+  }
+}
+
+void replayRecordInput(TetrisRecorder* recorder, UserAction action, bool hold,
+                       bool batched) {
+  if (action != kActionUp) {
+    writeRecord(recorder, (unsigned)batched << 4 | (unsigned)hold << 3 |
+                              (unsigned)action);
+  }
+}
+
+void replayRecordTick(TetrisRecorder* recorder, const GameState* gs) {
+  recorder->pendingTicks++;
+  recorder->ticks++;
+  if (recorder->keyframeInterval &&
+      recorder->ticks % recorder->keyframeInterval == 0) {
+    writeKeyframe(recorder, gs);
+  }
+}
+
+void replayFreeRecorder(TetrisRecorder* recorder) {
+  if (recorder) {
+    free(recorder->data);
+    free(recorder->keyframes);
+    free(recorder);
+  }
+}
+
+int tetris_startRecording(TetrisGame* game) {
+  const GameState* gs = &game->state;
+  if (game->recorder || gs->state != kStart) {
+    fprintf(stderr, "Recording must start before the game starts\n");
+    return 1;
+  }
+  TetrisRecorder* recorder = calloc(1, sizeof(TetrisRecorder));
+  if (!recorder || !reserveBytes(recorder, kReplayHeaderSize)) {
+    fprintf(stderr, "Failed to allocate replay recorder\n");
+    free(recorder);
+    return 1;
+  }
+  uint8_t* header = recorder->data;
+  memcpy(header, kReplayMagic, sizeof(kReplayMagic));
+  header[4] = kReplayVersion;
+  header[5] = kRow;
+  header[6] = (uint8_t)gs->randomizer;
+  header[7] = gs->bagLeft;
+  for (int i = 0; i < 8; ++i) {
+    header[8 + i] = (uint8_t)(gs->randomState >> (8 * i));
+  }
+  recorder->size = kReplayHeaderSize;
+  recorder->keyframeInterval = kReplayKeyframeInterval;
+  game->recorder = recorder;
+  return 0;
+}
+
+int tetris_finishRecording(TetrisGame* game, uint8_t** data, size_t* size) {
+  TetrisRecorder* recorder = game->recorder;
+  if (!recorder) {
+    return 1;
+  }
+  game->recorder = NULL;
+  writeRecord(recorder, kReplayControl);
+  writeVarint(recorder, kReplayEnd);
+  writeVarint(recorder, (uint64_t)game->state.stats.score);
+  writeVarint(recorder, (uint64_t)game->state.linesCleared);
+  writeIndex(recorder);
+  int status = recorder->failed;
+  if (!status) {
+    *data = recorder->data;
+    *size = recorder->size;
+    recorder->data = NULL;
+  }
+  replayFreeRecorder(recorder);
+  return status;
+}
+
+int tetris_saveRecording(TetrisGame* game, const char* path) {
+  uint8_t* data;
+  size_t size;
+  if (tetris_finishRecording(game, &data, &size) != 0) {
+    fprintf(stderr, "Failed to write replay to %s\n", path);
+    return 1;
+  }
+  FILE* file = fopen(path, "wb");
+  int status = !file || fwrite(data, 1, size, file) != size;
+  if (file && fclose(file) != 0) {
+    status = 1;
+  }
+  if (status) {
+    fprintf(stderr, "Failed to write replay to %s\n", path);
+  }
+  free(data);
+  return status;
+}
+
+/**
+ * Checks the log header and loads the piece generator it holds.
+ * @param gs Pointer to the game state.
+ * @param data The log.
+ * @param size The log size in bytes.
+ * @return True if the header is valid.
+ */
+static bool readHeader(GameState* gs, const uint8_t* data, size_t size) {
+  if (size < kReplayHeaderSize || memcmp(data, kReplayMagic, 4) != 0 ||
+      data[4] < 1 || data[4] > kReplayVersion || data[5] != kRow ||
+      data[6] > kRandomizerBag) {
+    return false;
+  }
+  gs->randomizer = (PieceRandomizer)data[6];
+  gs->bagLeft = data[7];
+  gs->randomState = 0;
+  for (int i = 0; i < 8; ++i) {
+    gs->randomState |= (uint64_t)data[8 + i] << (8 * i);
+  }
+  return true;
+}
+
+/**
+ * Tells whether tetris_tick() leaves a game unchanged: the game has not
+ * started, is paused or is over.
+ * @param gs Pointer to the game state.
+ * @return True if ticks are no-ops.
+ */
+static bool ticksIdle(const GameState* gs) {
+  return gs->state == kStart || gs->state == kGameOver || gs->stats.pause;
+}
+
+/**
+ * Plays records until the log ends or the given tick is reached. Inputs
+ * recorded right after the limit tick are left unplayed.
+ * @param game The game instance.
+ * @param cursor The decoder position, advanced past the played records.
+ * @param limit Tick to stop at.
+ * @param result Pointer to receive the outcome at kReplayEnd (may be NULL).
+ * @return kPlayEnd, kPlayLimit or kPlayMalformed.
+ */
+static int playRecords(TetrisGame* game, ReplayCursor* cursor, uint64_t limit,
+                       ReplayResult* result) {
+  GameState* gs = &game->state;
+  const uint8_t* data = cursor->data;
+  uint64_t record;
+  while (cursor->tick < limit &&
+         readVarint(data, cursor->size, &cursor->pos, &record)) {
+    uint64_t ticks = record >> kReplayFlagBits;
+    if (ticks > limit - cursor->tick) {
+      ticks = limit - cursor->tick;
+    }
+    // Тики без изменений только отсчитываются: один varint может нести
+    // до 2^59 тиков, и их симуляция заняла бы поток надолго.
+    for (uint64_t tick = ticks; tick > 0 && !ticksIdle(gs); --tick) {
+      tetris_tick(game);
+    }
+    cursor->tick += ticks;
+    unsigned code = (unsigned)(record & ((1u << kReplayActionBits) - 1));
+    UserAction action = (UserAction)code;
+    bool hold = (record >> 3) & 1;
+    uint64_t control, score, lines, length;
+    if (code != kReplayControl) {
+      // Ввод после граничного тика уже не относится к искомому состоянию.
+      if (cursor->tick == limit) {
+        return kPlayLimit;
+      } else if (gs->state == kGameOver) {
+        // Запись не хранит ввод после конца игры.
+        return kPlayMalformed;
+      } else if ((record >> 4) & 1) {
+        tetris_userInputBatch(game, &action, &hold, 1);
+      } else {
+        tetris_userInput(game, action, hold);
+      }
+    } else if (!readVarint(data, cursor->size, &cursor->pos, &control)) {
+      return kPlayMalformed;
+    } else if (control == kReplayKeyframe) {
+      if (!readVarint(data, cursor->size, &cursor->pos, &length) ||
+          length > cursor->size - cursor->pos) {
+        return kPlayMalformed;
+      }
+      cursor->pos += length;
+    } else if (control != kReplayEnd ||
+               !readVarint(data, cursor->size, &cursor->pos, &score) ||
+               !readVarint(data, cursor->size, &cursor->pos, &lines)) {
+      return kPlayMalformed;
+    } else {
+      if (result) {
+        result->ticks = cursor->tick;
+        result->score = gs->stats.score;
+        result->lines = gs->linesCleared;
+        result->expectedScore = (int)score;
+        result->expectedLines = (int)lines;
+      }
+      return kPlayEnd;
+    }
+  }
+  return cursor->tick == limit ? kPlayLimit : kPlayMalformed;
+}
+
+int tetris_replay(TetrisGame* game, const uint8_t* data, size_t size,
+                  ReplayResult* result) {
+  GameState* gs = &game->state;
+  if (gs->state != kStart || !readHeader(gs, data, size)) {
+    return 1;
+  }
+  memset(result, 0, sizeof(*result));
+  ReplayCursor cursor = {data, size, kReplayHeaderSize, 0};
+  return playRecords(game, &cursor, UINT64_MAX, result) != kPlayEnd;
+}
+
+/**
+ * Finds the last keyframe at or before a tick through the log index.
+ * @param data The log.
+ * @param size The log size in bytes.
+ * @param tick The target tick.
+ * @param keyframe Pointer to receive the keyframe.
+ * @return True if such a keyframe exists.
+ */
+static bool findKeyframe(const uint8_t* data, size_t size, uint64_t tick,
+                         ReplayKeyframe* keyframe) {
+  if (size < kReplayHeaderSize + kReplayTrailerSize ||
+      data[4] != kReplayVersion ||
+      memcmp(data + size - 4, kIndexMagic, sizeof(kIndexMagic)) != 0) {
+    return false;
+  }
+  const uint8_t* trailer = data + size - kReplayTrailerSize;
+  size_t pos = 0;
+  for (int i = 0; i < 4; ++i) {
+    pos |= (size_t)trailer[i] << (8 * i);
+  }
+  size_t end = size - kReplayTrailerSize;
+  uint64_t count, delta, offset;
+  uint64_t current = 0;
+  bool found = false;
+  if (pos > end || !readVarint(data, end, &pos, &count)) {
+    return false;
+  }
+  for (uint64_t i = 0; i < count; ++i) {
+    if (!readVarint(data, end, &pos, &delta) ||
+        !readVarint(data, end, &pos, &offset)) {
+      return false;
+    }
+    current += delta;
+    if (current > tick) {
+      break;
+    }
+    if (offset >= kReplayHeaderSize && offset <= end &&
+        kReplayKeyframeSize <= end - offset) {
+      keyframe->tick = current;
+      keyframe->offset = offset;
+      found = true;
+    }
+  }
+  return found;
+}
+
+int tetris_seekReplay(TetrisGame* game, const uint8_t* data, size_t size,
+                      uint64_t tick, uint64_t* reached) {
+  GameState* gs = &game->state;
+  if (game->recorder) {
+    return 1;
+  }
+  memset(gs, 0, sizeof(*gs));
+  gs->nextTetrominoType = kNoTetromino;
+  if (!readHeader(gs, data, size)) {
+    return 1;
+  }
+  ReplayCursor cursor = {data, size, kReplayHeaderSize, 0};
+  ReplayKeyframe keyframe = {0, 0};
+  if (findKeyframe(data, size, tick, &keyframe)) {
+    if (!decodeKeyframe(data + keyframe.offset, gs)) {
+      return 1;
+    }
+    cursor.pos = keyframe.offset + kReplayKeyframeSize;
+    cursor.tick = keyframe.tick;
+  }
+  int status = playRecords(game, &cursor, tick, NULL);
+  if (reached) {
+    *reached = cursor.tick;
+  }
+  return status == kPlayMalformed;
+}
@@ -0,0 +1,159 @@
+#ifndef TETRIS_REPLAY_H_
+#define TETRIS_REPLAY_H_
+
+#include "tetris.h"
+
+// Replay log layout. All integers are little-endian.
+//
+// Header (kReplayHeaderSize bytes):
+//   "TTRP", version, kRow, randomizer, bagLeft, generator state (8 bytes)
+// Records, one varint each:
+//   tickDelta << 5 | batched << 4 | hold << 3 | action
+// where tickDelta is the number of ticks since the previous record and
+// batched marks actions applied through tetris_userInputBatch(). The code
+// of kActionUp, a no-op that is never recorded, marks a control record
+// followed by a control byte:
+//   kReplayKeyframe: varint size, then the keyframe of the state right
+//                    after the tick the record lands on
+//   kReplayEnd:      final score and lines cleared as varints
+// The kReplayEnd record holds the trailing ticks and ends the records.
+// Index (version 2 and later):
+//   varint count, then per keyframe a varint tick delta from the previous
+//   keyframe and a varint offset of its GameState bytes
+// Trailer (kReplayTrailerSize bytes): index offset (4 bytes), "TTRI"
+// Keyframe (kReplayKeyframeSize bytes), signed fields in two's complement:
+//   state, tetromino type, next type (0xFF for none), rotation, move
+//   direction, piece active, randomizer, bagLeft (1 byte each); x, y,
+//   ghostY (2 bytes each); score, high score, level, speed, pause, points
+//   toward level, lines cleared (4 bytes each); generator state (8 bytes);
+//   kRow board rows (2 bytes each). Column heights and the board hash are
+//   rebuilt from the rows.
+// Version 1 logs have neither keyframes nor an index. Versions 2 and 3
+// stored the raw GameState as keyframe, so seeking ignores the keyframes
+// of logs older than version 4.
+enum {
+  kReplayVersion = 4,             // Format version.
+  kReplayHeaderSize = 16,         // Bytes before the first record.
+  kReplayTrailerSize = 8,         // Bytes after the index.
+  kReplayActionBits = 3,          // Bits of the action code.
+  kReplayFlagBits = 5,            // Action code plus hold and batched flags.
+  kReplayControl = kActionUp,     // Action code of control records.
+  kReplayEnd = 0,                 // Control byte ending the record stream.
+  kReplayKeyframe = 1,            // Control byte of a keyframe.
+  kReplayKeyframeInterval = 4096  // Default ticks between keyframes.
+};
+
+// Bytes of a keyframe.
+enum { kReplayKeyframeSize = 50 + 2 * kRow };
+
+// Keyframe entry of the replay index.
+typedef struct {
+  uint64_t tick;    // Ticks simulated when the keyframe was taken.
+  uint64_t offset;  // Offset of its GameState bytes in the log.
+} ReplayKeyframe;
+
+// Encoder attached to a game instance by tetris_startRecording().
+typedef struct TetrisRecorder {
+  uint8_t* data;              // Encoded log.
+  size_t size;                // Bytes used.
+  size_t capacity;            // Bytes allocated.
+  uint64_t pendingTicks;      // Ticks since the last record.
+  uint64_t ticks;             // Ticks recorded so far.
+  uint64_t keyframeInterval;  // Ticks between keyframes, 0 for none.
+  ReplayKeyframe* keyframes;  // Keyframes written so far.
+  size_t keyframeCount;       // Entries used in keyframes.
+  size_t keyframeCapacity;    // Entries allocated in keyframes.
+  bool failed;                // An allocation failed; the log is incomplete.
+} TetrisRecorder;
+
+// Outcome of replaying a log.
+typedef struct {
+  uint64_t ticks;     // Ticks simulated.
+  int score;          // Score reached by the replay.
+  int lines;          // Lines cleared by the replay.
+  int expectedScore;  // Score stored in the log.
+  int expectedLines;  // Lines stored in the log.
+} ReplayResult;
+
+/**
+ * Starts recording every input and tick of a game instance. The game must
+ * still be in kStart; the header captures its piece generator, so the
+ * game must be seeded and configured before this call. A keyframe is
+ * written every kReplayKeyframeInterval ticks; set
+ * game->recorder->keyframeInterval to change that.
+ * @param game The game instance.
+ * @return 0 on success, non-zero on error.
+ */
+int tetris_startRecording(TetrisGame* game);
+
+/**
+ * Ends the recording of a game instance and hands over the log.
+ * @param game The game instance.
+ * @param data Pointer to receive the log (free() it when done).
+ * @param size Pointer to receive the log size in bytes.
+ * @return 0 on success, non-zero if nothing was recorded or memory ran out.
+ */
+int tetris_finishRecording(TetrisGame* game, uint8_t** data, size_t* size);
+
+/**
+ * Ends the recording of a game instance and writes the log to a file.
+ * @param game The game instance.
+ * @param path Path of the file to create.
+ * @return 0 on success, non-zero on error.
+ */
+int tetris_saveRecording(TetrisGame* game, const char* path);
+
+/**
+ * Re-simulates a recorded game bit-exactly on a fresh game instance.
+ * Ticks while the game is paused or over are counted, not simulated, and
+ * an input after the game is over makes the log malformed.
+ * @param game A game instance in kStart, created by tetris_create().
+ * @param data The log.
+ * @param size The log size in bytes.
+ * @param result Pointer to receive the outcome.
+ * @return 0 on success, non-zero if the log is malformed.
+ */
+int tetris_replay(TetrisGame* game, const uint8_t* data, size_t size,
+                  ReplayResult* result);
+
+/**
+ * Loads the state a recorded game had right after the given tick. The
+ * nearest keyframe at or before the tick is restored from the index and
+ * only the ticks after it are simulated; logs without an index are played
+ * from the start.
+ * @param game A game instance created by tetris_create(), not recording.
+ *             Its state is replaced.
+ * @param data The log.
+ * @param size The log size in bytes.
+ * @param tick Target tick; targets past the end stop at the last tick.
+ * @param reached Pointer to receive the tick reached (may be NULL).
+ * @return 0 on success, non-zero if the log is malformed.
+ */
+int tetris_seekReplay(TetrisGame* game, const uint8_t* data, size_t size,
+                      uint64_t tick, uint64_t* reached);
+
+/**
+ * Records one user action. Called by the engine.
+ * @param recorder The recorder.
+ * @param action The user action.
+ * @param hold Whether the action is held.
+ * @param batched Whether the action came through tetris_userInputBatch().
+ */
+void replayRecordInput(TetrisRecorder* recorder, UserAction action, bool hold,
+                       bool batched);
+
+/**
+ * Records the end of a tick and writes a keyframe when one is due. Called
+ * by the engine after the tick has run.
+ * @param recorder The recorder.
+ * @param gs The game state after the tick.
+ */
+void replayRecordTick(TetrisRecorder* recorder, const GameState* gs);
+
+/**
+ * Frees a recorder and everything it holds.
+ * @param recorder The recorder (may be NULL).
+ */
+void replayFreeRecorder(TetrisRecorder* recorder);
+
+#endif
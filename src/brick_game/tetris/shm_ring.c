@@ -0,0 +1,294 @@
+#include "shm_ring.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+_Static_assert(ATOMIC_LLONG_LOCK_FREE == 2,
+               "Ring counters must be lock-free to be shared by processes");
+
+// Ring layout read from a header once. The handle keeps this copy so a
+// trainer that rewrites the header cannot move the rings.
+typedef struct {
+  uint32_t frameSlots;
+  uint32_t actionSlots;
+  uint64_t framesOffset;
+  uint64_t actionsOffset;
+} RingLayout;
+
+/**
+ * Checks a ring size.
+ * @param slots The size.
+ * @return True if it is a positive power of two.
+ */
+static bool validSlots(int slots) {
+  return slots > 0 && (slots & (slots - 1)) == 0;
+}
+
+/**
+ * Rounds a size up to a whole number of cache lines.
+ * @param size The size in bytes.
+ * @return The rounded size.
+ */
+static size_t alignLine(size_t size) {
+  return (size + kShmCacheLine - 1) / kShmCacheLine * kShmCacheLine;
+}
+
+/**
+ * Checks a ring layout against the mapped size.
+ * @param layout The layout.
+ * @param size Mapped bytes.
+ * @return True if both rings are valid and lie inside the segment.
+ */
+static bool validLayout(const RingLayout* layout, size_t size) {
+  return validSlots((int)layout->frameSlots) &&
+         validSlots((int)layout->actionSlots) &&
+         layout->framesOffset >= sizeof(TetrisShmHeader) &&
+         layout->framesOffset % _Alignof(TetrisObservation) == 0 &&
+         layout->framesOffset <= size &&
+         (uint64_t)layout->frameSlots * sizeof(TetrisObservation) <=
+             size - layout->framesOffset &&
+         layout->actionsOffset >= sizeof(TetrisShmHeader) &&
+         layout->actionsOffset <= size &&
+         layout->actionSlots <= size - layout->actionsOffset;
+}
+
+/**
+ * Allocates a handle for a mapped segment and points it at the rings.
+ * @param name Segment name.
+ * @param header The mapped segment.
+ * @param size Mapped bytes.
+ * @param layout The validated ring layout.
+ * @param owner True for the side that created the segment.
+ * @return The handle, NULL if the allocation failed (the segment is then
+ *         unmapped).
+ */
+static TetrisShmRing* attachRing(const char* name, TetrisShmHeader* header,
+                                 size_t size, const RingLayout* layout,
+                                 bool owner) {
+  TetrisShmRing* ring = calloc(1, sizeof(*ring));
+  if (!ring) {
+    fprintf(stderr, "Failed to allocate shared memory handle\n");
+    munmap(header, size);
+    return NULL;
+  }
+  ring->header = header;
+  ring->size = size;
+  ring->frames =
+      (TetrisObservation*)((uint8_t*)header + layout->framesOffset);
+  ring->actions = (uint8_t*)header + layout->actionsOffset;
+  ring->frameSlots = layout->frameSlots;
+  ring->actionSlots = layout->actionSlots;
+  ring->owner = owner;
+  ring->frameHead = atomic_load(&header->frameHead);
+  ring->frameTail = atomic_load(&header->frameTail);
+  ring->actionHead = atomic_load(&header->actionHead);
+  ring->actionTail = atomic_load(&header->actionTail);
+  ring->seq = ring->frameHead;
+  snprintf(ring->name, sizeof(ring->name), "%s", name);
+  return ring;
+}
+
+TetrisShmRing* tetris_shmCreate(const char* name, int frameSlots,
+                                int actionSlots) {
+  if (!validSlots(frameSlots) || !validSlots(actionSlots) ||
+      strlen(name) >= sizeof(((TetrisShmRing*)NULL)->name)) {
+    fprintf(stderr, "Invalid shared memory ring %s\n", name);
+    return NULL;
+  }
+  RingLayout layout = {.frameSlots = (uint32_t)frameSlots,
+                       .actionSlots = (uint32_t)actionSlots};
+  layout.framesOffset = alignLine(sizeof(TetrisShmHeader));
+  layout.actionsOffset = alignLine(
+      layout.framesOffset + (size_t)frameSlots * sizeof(TetrisObservation));
+  size_t size = alignLine(layout.actionsOffset + (size_t)actionSlots);
+  shm_unlink(name);
+  int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0) {
+    perror(name);
+    return NULL;
+  }
+  void* memory = MAP_FAILED;
+  if (ftruncate(fd, (off_t)size) == 0) {
+    memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  if (memory == MAP_FAILED) {
+    perror(name);
+    close(fd);
+    shm_unlink(name);
+    return NULL;
+  }
+  close(fd);
+  // ftruncate() заполняет сегмент нулями, счётчики колец уже равны 0.
+  TetrisShmHeader* header = memory;
+  header->magic = kShmMagic;
+  header->version = kShmVersion;
+  header->rows = kRow;
+  header->frameSize = sizeof(TetrisObservation);
+  header->frameSlots = layout.frameSlots;
+  header->actionSlots = layout.actionSlots;
+  header->framesOffset = layout.framesOffset;
+  header->actionsOffset = layout.actionsOffset;
+  TetrisShmRing* ring = attachRing(name, header, size, &layout, true);
+  if (!ring) {
+    shm_unlink(name);
+  }
+  return ring;
+}
+
+TetrisShmRing* tetris_shmOpen(const char* name) {
+  if (strlen(name) >= sizeof(((TetrisShmRing*)NULL)->name)) {
+    fprintf(stderr, "Invalid shared memory ring %s\n", name);
+    return NULL;
+  }
+  int fd = shm_open(name, O_RDWR, 0);
+  if (fd < 0) {
+    perror(name);
+    return NULL;
+  }
+  struct stat info;
+  void* memory = MAP_FAILED;
+  if (fstat(fd, &info) == 0 &&
+      (size_t)info.st_size >= sizeof(TetrisShmHeader)) {
+    memory = mmap(NULL, (size_t)info.st_size, PROT_READ | PROT_WRITE,
+                  MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (memory == MAP_FAILED) {
+    fprintf(stderr, "Failed to map shared memory ring %s\n", name);
+    return NULL;
+  }
+  size_t size = (size_t)info.st_size;
+  TetrisShmHeader* header = memory;
+  // Размеры колец читаются из сегмента один раз и дальше берутся только
+  // из проверенной копии.
+  RingLayout layout = {.frameSlots = header->frameSlots,
+                       .actionSlots = header->actionSlots,
+                       .framesOffset = header->framesOffset,
+                       .actionsOffset = header->actionsOffset};
+  if (header->magic != kShmMagic || header->version != kShmVersion ||
+      header->rows != kRow ||
+      header->frameSize != sizeof(TetrisObservation) ||
+      !validLayout(&layout, size)) {
+    fprintf(stderr, "Shared memory ring %s has another layout\n", name);
+    munmap(memory, size);
+    return NULL;
+  }
+  return attachRing(name, header, size, &layout, false);
+}
+
+void tetris_shmClose(TetrisShmRing* ring) {
+  if (ring) {
+    munmap(ring->header, ring->size);
+    if (ring->owner) {
+      shm_unlink(ring->name);
+    }
+    free(ring);
+  }
+}
+
+/**
+ * Fills an observation from a game state.
+ * @param frame The frame slot.
+ * @param gs The game state.
+ * @param seq Frame number.
+ */
+static void fillObservation(TetrisObservation* frame, const GameState* gs,
+                            uint64_t seq) {
+  frame->seq = seq;
+  memcpy(frame->field, gs->board, sizeof(frame->field));
+  bool active = gs->pieceActive;
+  const PieceMask* piece =
+      active ? &kPieceMasks[gs->tetrominoType][gs->rotationIndex] : NULL;
+  bool hasNext = hasNextTetromino(gs);
+  for (int i = 0; i < kFigureSize; ++i) {
+    frame->piece[i] = active ? piece->rows[i] : 0;
+    frame->next[i] =
+        hasNext ? kPieceMasks[gs->nextTetrominoType][0].rows[i] : 0;
+  }
+  frame->pieceType = (int8_t)(active ? gs->tetrominoType : kNoTetromino);
+  frame->rotation = (int8_t)(active ? gs->rotationIndex : 0);
+  frame->nextType = (int8_t)(hasNext ? gs->nextTetrominoType : kNoTetromino);
+  frame->state = (uint8_t)gs->state;
+  frame->x = (int16_t)(active ? gs->tetrominoX : 0);
+  frame->y = (int16_t)(active ? gs->tetrominoY : 0);
+  frame->ghostY = (int16_t)(active ? gs->ghostY : 0);
+  frame->pause = (int16_t)gs->stats.pause;
+  frame->score = gs->stats.score;
+  frame->level = gs->stats.level;
+  frame->lines = gs->linesCleared;
+}
+
+bool tetris_shmPublish(TetrisShmRing* ring, const GameState* gs) {
+  TetrisShmHeader* header = ring->header;
+  uint64_t seq = ++ring->seq;
+  if (ring->frameHead - ring->frameTail == ring->frameSlots) {
+    ring->frameTail =
+        atomic_load_explicit(&header->frameTail, memory_order_acquire);
+    if (ring->frameHead - ring->frameTail == ring->frameSlots) {
+      return false;
+    }
+  }
+  uint64_t slot = ring->frameHead & (ring->frameSlots - 1);
+  fillObservation(&ring->frames[slot], gs, seq);
+  atomic_store_explicit(&header->frameHead, ++ring->frameHead,
+                        memory_order_release);
+  return true;
+}
+
+const TetrisObservation* tetris_shmPeekFrame(TetrisShmRing* ring) {
+  TetrisShmHeader* header = ring->header;
+  if (ring->frameTail == ring->frameHead) {
+    ring->frameHead =
+        atomic_load_explicit(&header->frameHead, memory_order_acquire);
+    if (ring->frameTail == ring->frameHead) {
+      return NULL;
+    }
+  }
+  return &ring->frames[ring->frameTail & (ring->frameSlots - 1)];
+}
+
+void tetris_shmReleaseFrame(TetrisShmRing* ring) {
+  atomic_store_explicit(&ring->header->frameTail, ++ring->frameTail,
+                        memory_order_release);
+}
+
+bool tetris_shmPushAction(TetrisShmRing* ring, UserAction action) {
+  TetrisShmHeader* header = ring->header;
+  if (ring->actionHead - ring->actionTail == ring->actionSlots) {
+    ring->actionTail =
+        atomic_load_explicit(&header->actionTail, memory_order_acquire);
+    if (ring->actionHead - ring->actionTail == ring->actionSlots) {
+      return false;
+    }
+  }
+  ring->actions[ring->actionHead & (ring->actionSlots - 1)] =
+      (uint8_t)action;
+  atomic_store_explicit(&header->actionHead, ++ring->actionHead,
+                        memory_order_release);
+  return true;
+}
+
+bool tetris_shmPopAction(TetrisShmRing* ring, UserAction* action) {
+  TetrisShmHeader* header = ring->header;
+  bool taken = false;
+  while (!taken) {
+    if (ring->actionTail == ring->actionHead) {
+      ring->actionHead =
+          atomic_load_explicit(&header->actionHead, memory_order_acquire);
+      if (ring->actionTail == ring->actionHead) {
+        return false;
+      }
+    }
+    uint8_t code = ring->actions[ring->actionTail & (ring->actionSlots - 1)];
+    atomic_store_explicit(&header->actionTail, ++ring->actionTail,
+                          memory_order_release);
+    // Коды вне UserAction от чужого процесса пропускаются.
+    if (code <= kActionRotate) {
+      *action = (UserAction)code;
+      taken = true;
+    }
+  }
+  return true;
+}
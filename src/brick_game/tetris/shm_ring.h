@@ -0,0 +1,146 @@
+#ifndef TETRIS_SHM_RING_H_
+#define TETRIS_SHM_RING_H_
+
+#include <stdatomic.h>
+
+#include "tetris.h"
+
+// Shared memory layout. All integers are native-endian; the segment is
+// only shared between processes on one machine.
+//
+// TetrisShmHeader, then frameSlots TetrisObservation entries at
+// framesOffset, then actionSlots uint8_t UserAction codes at
+// actionsOffset. Each ring is single-producer single-consumer: the engine
+// writes frames and reads actions, the trainer does the opposite. A head
+// counts the entries written and a tail the entries consumed; both only
+// grow, and entry n lives in slot n % slots.
+enum {
+  kShmMagic = 0x4D485354,  // "TSHM".
+  kShmVersion = 1,         // Layout version.
+  kShmFrameSlots = 256,    // Default frame ring size.
+  kShmActionSlots = 256,   // Default action ring size.
+  kShmCacheLine = 64       // Counters of each side sit on their own line.
+};
+
+// Observation of one frame, written in place into the frame ring.
+typedef struct {
+  uint64_t seq;                // Frame number, 1 for the first; gaps are
+                               // frames dropped on a full ring.
+  uint16_t field[kRow];        // Locked cells, bit x of row y is (x, y).
+  uint8_t piece[kFigureSize];  // Falling tetromino rows, bit j is column j.
+  uint8_t next[kFigureSize];   // Next tetromino rows, bit j is column j.
+  int8_t pieceType;            // Falling tetromino type or kNoTetromino.
+  int8_t rotation;             // Rotation index of the falling tetromino.
+  int8_t nextType;             // Next tetromino type or kNoTetromino.
+  uint8_t state;               // FsmState.
+  int16_t x;                   // Column of the piece rows' bit 0.
+  int16_t y;                   // Field row of piece[0].
+  int16_t ghostY;              // Field row of piece[0] after a hard drop.
+  int16_t pause;               // Pause flag, -1 once the game is over.
+  int32_t score;               // Current score.
+  int32_t level;               // Current level.
+  int32_t lines;               // Lines cleared since the game start.
+} TetrisObservation;
+
+// Start of the shared segment.
+typedef struct {
+  uint32_t magic;          // kShmMagic.
+  uint32_t version;        // kShmVersion.
+  uint32_t rows;           // kRow of the engine.
+  uint32_t frameSize;      // sizeof(TetrisObservation).
+  uint32_t frameSlots;     // Frame ring size, a power of two.
+  uint32_t actionSlots;    // Action ring size, a power of two.
+  uint64_t framesOffset;   // Offset of the frame ring.
+  uint64_t actionsOffset;  // Offset of the action ring.
+  // Frames written, frames read, actions written, actions read.
+  _Alignas(kShmCacheLine) atomic_uint_least64_t frameHead;
+  _Alignas(kShmCacheLine) atomic_uint_least64_t frameTail;
+  _Alignas(kShmCacheLine) atomic_uint_least64_t actionHead;
+  _Alignas(kShmCacheLine) atomic_uint_least64_t actionTail;
+} TetrisShmHeader;
+
+// Process-local handle of a mapped segment. Each side keeps its own copy
+// of the other side's counter and rereads it only when a ring looks full
+// or empty, so the shared lines move between cores only on those checks.
+typedef struct {
+  TetrisShmHeader* header;    // Mapped segment.
+  size_t size;                // Mapped bytes.
+  TetrisObservation* frames;  // Frame ring.
+  uint8_t* actions;           // Action ring.
+  uint32_t frameSlots;        // Validated copy of header->frameSlots.
+  uint32_t actionSlots;       // Validated copy of header->actionSlots.
+  bool owner;                 // Created the segment; unlinks it on close.
+  uint64_t frameHead;         // Local copy of header->frameHead.
+  uint64_t frameTail;         // Local copy of header->frameTail.
+  uint64_t actionHead;        // Local copy of header->actionHead.
+  uint64_t actionTail;        // Local copy of header->actionTail.
+  uint64_t seq;               // Frames offered by tetris_shmPublish().
+  char name[64];              // Name passed to shm_open().
+} TetrisShmRing;
+
+/**
+ * Creates a segment with shm_open()/mmap() for the engine side. An
+ * existing segment of the same name is replaced.
+ * @param name Segment name, starting with '/' (see shm_open(3)).
+ * @param frameSlots Frame ring size, a power of two.
+ * @param actionSlots Action ring size, a power of two.
+ * @return The handle, NULL on error.
+ */
+TetrisShmRing* tetris_shmCreate(const char* name, int frameSlots,
+                                int actionSlots);
+
+/**
+ * Maps an existing segment for the trainer side.
+ * @param name Segment name used by tetris_shmCreate().
+ * @return The handle, NULL on error or on a layout mismatch.
+ */
+TetrisShmRing* tetris_shmOpen(const char* name);
+
+/**
+ * Unmaps a segment; the creator also removes its name.
+ * @param ring The handle (may be NULL).
+ */
+void tetris_shmClose(TetrisShmRing* ring);
+
+/**
+ * Writes the observation of a game straight into the next frame slot.
+ * The frame is dropped when the trainer has not consumed the ring.
+ * Engine side only.
+ * @param ring The handle.
+ * @param gs The game state.
+ * @return True if the frame was written, false if it was dropped.
+ */
+bool tetris_shmPublish(TetrisShmRing* ring, const GameState* gs);
+
+/**
+ * Returns the oldest unread frame in place, without copying. It stays
+ * valid until tetris_shmReleaseFrame(). Trainer side only.
+ * @param ring The handle.
+ * @return The frame, NULL if the ring is empty.
+ */
+const TetrisObservation* tetris_shmPeekFrame(TetrisShmRing* ring);
+
+/**
+ * Hands the frame returned by tetris_shmPeekFrame() back to the engine.
+ * @param ring The handle.
+ */
+void tetris_shmReleaseFrame(TetrisShmRing* ring);
+
+/**
+ * Queues an action for the engine. Trainer side only.
+ * @param ring The handle.
+ * @param action The action.
+ * @return True if the action was queued, false if the ring is full.
+ */
+bool tetris_shmPushAction(TetrisShmRing* ring, UserAction action);
+
+/**
+ * Takes the oldest queued action. Engine side only.
+ * @param ring The handle.
+ * @param action Pointer to receive the action.
+ * @return True if an action was taken, false if the ring is empty. Codes
+ *         that are not a UserAction are skipped.
+ */
+bool tetris_shmPopAction(TetrisShmRing* ring, UserAction* action);
+
+#endif
@@ -1,5 +1,7 @@
 #include "tetris.h"
 
+#include "replay.h"
+
 #ifdef INSTALL
 const char* kHighScorePath = "/usr/local/share/tetris/high_score.txt";
 #else
@@ -36,14 +38,96 @@ const int kTetrominoShapes[][4][kFigureSize][kFigureSize] = {
      {{0, 0, 0, 0}, {0, 1, 1, 0}, {0, 1, 0, 0}, {0, 1, 0, 0}},
      {{0, 0, 0, 0}, {1, 1, 1, 0}, {0, 0, 1, 0}, {0, 0, 0, 0}}}};
 
+// Spawn position of the 4x4 shape grid.
+enum { kSpawnX = kCol / 2 - kFigureSize / 2, kSpawnY = 0 };
+
+// Packed row masks of kTetrominoShapes, one entry per distinct rotation.
+const PieceMask kPieceMasks[][4] = {
+    {  // I
+     {{0x0, 0xF, 0x0, 0x0}, 0, 1, 4, 1,
+      {-1, 0, -1, -1}, {-1, 3, -1, -1}, {1, 1, 1, 1}, kSpawnX, kSpawnY},
+     {{0x4, 0x4, 0x4, 0x4}, 2, 0, 1, 4,
+      {2, 2, 2, 2}, {2, 2, 2, 2}, {-1, -1, 3, -1}, kSpawnX, kSpawnY}},
+    {  // L
+     {{0x2, 0x2, 0x6, 0x0}, 1, 0, 2, 3,
+      {1, 1, 1, -1}, {1, 1, 2, -1}, {-1, 2, 2, -1}, kSpawnX, kSpawnY},
+     {{0x0, 0xE, 0x2, 0x0}, 1, 1, 3, 2,
+      {-1, 1, 1, -1}, {-1, 3, 1, -1}, {-1, 2, 1, 1}, kSpawnX, kSpawnY},
+     {{0x0, 0x6, 0x4, 0x4}, 1, 1, 2, 3,
+      {-1, 1, 2, 2}, {-1, 2, 2, 2}, {-1, 1, 3, -1}, kSpawnX, kSpawnY},
+     {{0x0, 0x4, 0x7, 0x0}, 0, 1, 3, 2,
+      {-1, 2, 0, -1}, {-1, 2, 2, -1}, {2, 2, 2, -1}, kSpawnX, kSpawnY}},
+    {  // O
+     {{0x6, 0x6, 0x0, 0x0}, 1, 0, 2, 2,
+      {1, 1, -1, -1}, {2, 2, -1, -1}, {-1, 1, 1, -1}, kSpawnX, kSpawnY}},
+    {  // T
+     {{0x2, 0x7, 0x0, 0x0}, 0, 0, 3, 2,
+      {1, 0, -1, -1}, {1, 2, -1, -1}, {1, 1, 1, -1}, kSpawnX, kSpawnY},
+     {{0x2, 0x6, 0x2, 0x0}, 1, 0, 2, 3,
+      {1, 1, 1, -1}, {1, 2, 1, -1}, {-1, 2, 1, -1}, kSpawnX, kSpawnY},
+     {{0x0, 0x7, 0x2, 0x0}, 0, 1, 3, 2,
+      {-1, 0, 1, -1}, {-1, 2, 1, -1}, {1, 2, 1, -1}, kSpawnX, kSpawnY},
+     {{0x2, 0x3, 0x2, 0x0}, 0, 0, 2, 3,
+      {1, 0, 1, -1}, {1, 1, 1, -1}, {1, 2, -1, -1}, kSpawnX, kSpawnY}},
+    {  // S
+     {{0x3, 0x6, 0x0, 0x0}, 0, 0, 3, 2,
+      {0, 1, -1, -1}, {1, 2, -1, -1}, {0, 1, 1, -1}, kSpawnX, kSpawnY},
+     {{0x4, 0x6, 0x2, 0x0}, 1, 0, 2, 3,
+      {2, 1, 1, -1}, {2, 2, 1, -1}, {-1, 2, 1, -1}, kSpawnX, kSpawnY}},
+    {  // Z
+     {{0x6, 0x3, 0x0, 0x0}, 0, 0, 3, 2,
+      {1, 0, -1, -1}, {2, 1, -1, -1}, {1, 1, 0, -1}, kSpawnX, kSpawnY},
+     {{0x2, 0x6, 0x4, 0x0}, 1, 0, 2, 3,
+      {1, 1, 2, -1}, {1, 2, 2, -1}, {-1, 1, 2, -1}, kSpawnX, kSpawnY}},
+    {  // J
+     {{0x4, 0x4, 0x6, 0x0}, 1, 0, 2, 3,
+      {2, 2, 1, -1}, {2, 2, 2, -1}, {-1, 2, 2, -1}, kSpawnX, kSpawnY},
+     {{0x0, 0x2, 0xE, 0x0}, 1, 1, 3, 2,
+      {-1, 1, 1, -1}, {-1, 1, 3, -1}, {-1, 2, 2, 2}, kSpawnX, kSpawnY},
+     {{0x0, 0x6, 0x2, 0x2}, 1, 1, 2, 3,
+      {-1, 1, 1, 1}, {-1, 2, 1, 1}, {-1, 3, 1, -1}, kSpawnX, kSpawnY},
+     {{0x0, 0x7, 0x4, 0x0}, 0, 1, 3, 2,
+      {-1, 0, 2, -1}, {-1, 2, 2, -1}, {1, 1, 2, -1}, kSpawnX, kSpawnY}}};
+
+/**
+ * Places a grid row mask of a piece at field column x.
+ * @param row Row mask in grid coordinates.
+ * @param x Field x-coordinate of the grid’s left edge (>= -kFigureSize).
+ * @return The row mask in field coordinates.
+ */
+static inline uint16_t placeRow(unsigned row, int x) {
+  return (uint16_t)((row << (x + kFigureSize)) >> kFigureSize);
+}
+
 const int* getRotationsPerTetromino() {
   static const int rotations[] = {2, 4, 1, 4, 2, 2, 4};
   return rotations;
 }
 
-GameState* getGameState() {
-  static GameState gameState = {0};
-  return &gameState;
+TetrisGame* getDefaultGame() {
+  static TetrisGame game = {
+      .state = {.nextTetrominoType = kNoTetromino, .persistHighScore = true}};
+  return &game;
+}
+
+GameState* getGameState() { return &getDefaultGame()->state; }
+
+TetrisGame* tetris_create(void) {
+  TetrisGame* game = calloc(1, sizeof(TetrisGame));
+  if (!game) {
+    fprintf(stderr, "Failed to allocate game instance\n");
+  } else {
+    game->state.nextTetrominoType = kNoTetromino;
+  }
+  return game;
+}
+
+void tetris_destroy(TetrisGame* game) {
+  if (game) {
+    cleanupGame(game);
+    replayFreeRecorder(game->recorder);
+    free(game);
+  }
 }
 
 int** allocMatrix(int rows, int cols) {
@@ -75,157 +159,307 @@ void freeMatrix(int** matrix, int rows) {
   }
 }
 
-TetrominoPoints spawnTetromino(GameInfo* gameInfo, int x, int y, int type,
-                               int rotationIndex) {
-  TetrominoPoints tetromino = {0};
-  int count = 0;
-  const int(*shape)[kFigureSize] = kTetrominoShapes[type][rotationIndex];
-  for (int i = 0; i < kFigureSize && count < kFigurePoints; ++i) {
-    for (int j = 0; j < kFigureSize && count < kFigurePoints; ++j) {
-      if (shape[i][j]) {
-        int newX = j + x;
-        int newY = i + y;
-        if (newX >= 0 && newX < kCol && newY >= 0 && newY < kRow) {
-          gameInfo->field[newY][newX] = shape[i][j];
-          tetromino.points[count].x = newX;
-          tetromino.points[count].y = newY;
-          count++;
-        }
-      }
+/**
+ * Draws the current tetromino into field rows at the given height.
+ * @param gs Pointer to the game state.
+ * @param rows Field rows to draw into (kRow entries).
+ * @param y Y-coordinate of the tetromino’s top-left corner.
+ */
+static void drawTetrominoAt(const GameState* gs, uint16_t* rows, int y) {
+  const PieceMask* piece = &kPieceMasks[gs->tetrominoType][gs->rotationIndex];
+  for (int i = piece->top; i < piece->top + piece->height; ++i) {
+    int row = y + i;
+    if (row >= 0 && row < kRow) {
+      rows[row] |= placeRow(piece->rows[i], gs->tetrominoX) & kFullRow;
     }
   }
-  for (; count < kFigurePoints; ++count) {
-    tetromino.points[count].x = -1;
-    tetromino.points[count].y = -1;
+}
+
+/**
+ * Recomputes the cached landing row after the piece moved sideways,
+ * rotated or spawned. Falling does not change it.
+ * @param gs Pointer to the game state.
+ */
+static void updateGhost(GameState* gs) {
+  gs->ghostY = landingRow(gs, gs->tetrominoType, gs->rotationIndex,
+                          gs->tetrominoX, gs->tetrominoY);
+}
+
+void spawnTetromino(GameState* gs, int x, int y, int type, int rotationIndex) {
+  gs->tetrominoType = type;
+  gs->rotationIndex = rotationIndex;
+  gs->tetrominoX = x;
+  gs->tetrominoY = y;
+  gs->pieceActive = true;
+  updateGhost(gs);
+}
+
+void overlayTetromino(const GameState* gs, uint16_t* rows) {
+  if (gs->pieceActive) {
+    drawTetrominoAt(gs, rows, gs->tetrominoY);
   }
-  return tetromino;
 }
 
-void generateNextTetromino(GameInfo* gameInfo, int* type, int* rotationIndex) {
-  *type = rand() % (sizeof(kTetrominoShapes) / sizeof(kTetrominoShapes[0]));
-  *rotationIndex = 0;
-  for (int i = 0; i < kFigureSize; ++i) {
-    for (int j = 0; j < kFigureSize; ++j) {
-      gameInfo->next[i][j] = kTetrominoShapes[*type][*rotationIndex][i][j];
+void overlayGhost(const GameState* gs, const uint16_t* field,
+                  uint16_t* ghost) {
+  memset(ghost, 0, kRow * sizeof(ghost[0]));
+  if (gs->pieceActive && gs->state != kGameOver) {
+    drawTetrominoAt(gs, ghost, gs->ghostY);
+    for (int i = 0; i < kRow; ++i) {
+      ghost[i] &= (uint16_t)~field[i];
     }
   }
 }
 
-bool hasNextTetromino(const GameInfo* gameInfo) {
-  for (int i = 0; i < kFigureSize; ++i) {
-    for (int j = 0; j < kFigureSize; ++j) {
-      if (gameInfo->next[i][j]) {
-        return true;
+void lockTetromino(GameState* gs) {
+  if (!gs->pieceActive) {
+    return;
+  }
+  const PieceMask* piece = &kPieceMasks[gs->tetrominoType][gs->rotationIndex];
+  for (int i = piece->top; i < piece->top + piece->height; ++i) {
+    int y = gs->tetrominoY + i;
+    if (y < 0 || y >= kRow) {
+      continue;
+    }
+    unsigned cells = placeRow(piece->rows[i], gs->tetrominoX) & kFullRow;
+    uint16_t row = gs->board[y];
+    gs->board[y] = row | (uint16_t)cells;
+    gs->boardHash ^= zobristRow(y, row) ^ zobristRow(y, gs->board[y]);
+    while (cells) {
+      int x = __builtin_ctz(cells);
+      cells &= cells - 1;
+      if (gs->columnHeights[x] < kRow - y) {
+        gs->columnHeights[x] = (uint8_t)(kRow - y);
       }
     }
   }
-  return false;
+  gs->pieceActive = false;
 }
 
-void renderField(GameInfo gameInfo) {
-  for (int i = 0; i < kRow; ++i) {
-    for (int j = 0; j < kCol; ++j) {
-      mvprintw(i, j, gameInfo.field[i][j] ? "o" : " ");
-    }
+/**
+ * Mixes a 64-bit value with the splitmix64 finalizer.
+ * @param value The value.
+ * @return The mixed value.
+ */
+static uint64_t splitMix(uint64_t value) {
+  value += 0x9E3779B97F4A7C15ULL;
+  value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+  return value ^ (value >> 31);
+}
+
+uint64_t zobristRow(int y, uint16_t row) {
+  return row ? splitMix((uint64_t)y << 16 | row) : 0;
+}
+
+uint64_t hashBoard(const uint16_t* board) {
+  uint64_t hash = 0;
+  for (int y = 0; y < kRow; ++y) {
+    hash ^= zobristRow(y, board[y]);
   }
-  for (int i = 0; i < kRow; ++i) {
-    mvprintw(i, kCol, "|");
+  return hash;
+}
+
+uint64_t positionHash(const GameState* gs) {
+  if (!gs->pieceActive) {
+    return gs->boardHash;
   }
-  for (int i = 0; i < kCol + 1; ++i) {
-    mvprintw(kRow, i, "-");
+  // Ключи фигуры лежат выше 2^32 и не пересекаются с ключами строк.
+  uint64_t piece = (uint64_t)(gs->tetrominoType + 1) << 32 |
+                   (uint64_t)gs->rotationIndex << 24 |
+                   (uint64_t)(uint8_t)gs->tetrominoX << 8 |
+                   (uint8_t)gs->tetrominoY;
+  return gs->boardHash ^ splitMix(piece);
+}
+
+void rebuildColumnHeights(GameState* gs) {
+  memset(gs->columnHeights, 0, sizeof(gs->columnHeights));
+  unsigned seen = 0;
+  for (int y = 0; y < kRow && seen != kFullRow; ++y) {
+    unsigned fresh = gs->board[y] & ~seen;
+    seen |= fresh;
+    while (fresh) {
+      gs->columnHeights[__builtin_ctz(fresh)] = (uint8_t)(kRow - y);
+      fresh &= fresh - 1;
+    }
   }
-  mvprintw(0, kCol + 3, "Next");
-  for (int i = 0; i < kFigureSize; ++i) {
-    for (int j = 0; j < kFigureSize; ++j) {
-      mvprintw(i + 2, j + kCol + 3, gameInfo.next[i][j] ? "o" : " ");
+}
+
+int landingRow(const GameState* gs, int type, int rotation, int x, int y) {
+  const PieceMask* piece = &kPieceMasks[type][rotation];
+  int landing = kRow;
+  for (int j = piece->left; j < piece->left + piece->width; ++j) {
+    int limit = kRow - 1 - gs->columnHeights[x + j] - piece->bottomSkirt[j];
+    if (limit < landing) {
+      landing = limit;
     }
   }
-  mvprintw(6, kCol + 3, "Level: %d", gameInfo.level);
-  mvprintw(7, kCol + 3, "Score: %d", gameInfo.score);
-  mvprintw(8, kCol + 3, "High Score: %d", gameInfo.high_score);
-  if (gameInfo.pause == 1) {
-    mvprintw(kRow / 2, kCol / 2 - 3, "PAUSED");
-  } else if (gameInfo.pause == -1) {
-    mvprintw(kRow / 2, kCol / 2 - 5, "GAME OVER");
+  // Фигура уже ниже поверхности одного из столбцов (под нависанием):
+  // высоты столбцов ничего не говорят, спускаемся проверкой столкновений.
+  if (landing < y) {
+    landing = y;
+    while (fits(gs, type, rotation, x, landing + 1)) {
+      landing++;
+    }
   }
-  refresh();
+  return landing;
 }
 
-void startGame(GameInfo* gameInfo) {
-  gameInfo->field = allocMatrix(kRow, kCol);
-  if (!gameInfo->field) {
-    fprintf(stderr, "Failed to allocate game field\n");
+void hardDropState(GameState* gs, FsmState* state) {
+  if (!gs->pieceActive) {
+    fallingTetrominoState(gs, state);
     return;
   }
-  gameInfo->next = allocMatrix(kFigureSize, kFigureSize);
-  if (!gameInfo->next) {
-    fprintf(stderr, "Failed to allocate next tetromino matrix\n");
-    freeMatrix(gameInfo->field, kRow);
-    gameInfo->field = NULL;
-    return;
-  }
-  gameInfo->score = 0;
-  gameInfo->high_score = 0;
-  gameInfo->level = 1;
-  gameInfo->speed = kSpeed;
-  gameInfo->pause = 0;
-  getGameState()->pointsTowardLevel = 0;
+  gs->tetrominoY = gs->ghostY;
+  *state = kLocking;
+}
 
-  FILE* file = fopen(kHighScorePath, "r");
-  if (file) {
-    if (fscanf(file, "%d", &gameInfo->high_score) != 1) {
-      gameInfo->high_score = 0;
-    }
-    fclose(file);
-  }
+uint32_t randomNext(uint64_t* state) {
+  uint64_t old = *state;
+  *state = old * 6364136223846793005ULL + 1442695040888963407ULL;
+  uint32_t xorshifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+  uint32_t rot = (uint32_t)(old >> 59);
+  return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+}
+
+/**
+ * Returns a random number in [0, bound) without a division.
+ * @param state Pointer to the generator state.
+ * @param bound Upper bound (exclusive).
+ * @return The random number.
+ */
+static int randomBelow(uint64_t* state, int bound) {
+  return (int)(((uint64_t)randomNext(state) * (uint32_t)bound) >> 32);
+}
+
+void tetris_seed(TetrisGame* game, uint64_t seed) {
+  GameState* gs = &game->state;
+  gs->randomState = 0;
+  randomNext(&gs->randomState);
+  gs->randomState += seed;
+  randomNext(&gs->randomState);
+  gs->bagLeft = 0;
 }
 
-void spawnTetrominoState(GameInfo* gameInfo, TetrominoPoints* currentTetromino,
-                         int* x, int* y, FsmState* state) {
-  GameState* gs = getGameState();
-  *x = kCol / 2 - kFigureSize / 2;
-  *y = 0;
+void tetris_save(const TetrisGame* game, TetrisSnapshot* snapshot) {
+  memcpy(&snapshot->state, &game->state, sizeof(GameState));
+}
+
+void tetris_restore(TetrisGame* game, const TetrisSnapshot* snapshot) {
+  // Работа с файлом рекорда принадлежит экземпляру, а не снимку.
+  bool persistHighScore = game->state.persistHighScore;
+  memcpy(&game->state, &snapshot->state, sizeof(GameState));
+  game->state.persistHighScore = persistHighScore;
+}
+
+void tetris_setRandomizer(TetrisGame* game, PieceRandomizer randomizer) {
+  game->state.randomizer = randomizer;
+  game->state.bagLeft = 0;
+}
 
-  if (!hasNextTetromino(gameInfo)) {
-    generateNextTetromino(gameInfo, &gs->nextTetrominoType, &gs->rotationIndex);
+int dealTetromino(uint64_t* randomState, uint8_t* bagLeft,
+                  PieceRandomizer randomizer) {
+  enum { kTypes = sizeof(kTetrominoShapes) / sizeof(kTetrominoShapes[0]) };
+  if (randomizer != kRandomizerBag) {
+    return randomBelow(randomState, kTypes);
   }
+  // Мешок хранится битовой маской оставшихся типов: выбирается k-й
+  // установленный бит, пустой мешок заполняется заново.
+  if (!*bagLeft) {
+    *bagLeft = (1u << kTypes) - 1;
+  }
+  unsigned left = *bagLeft;
+  for (int k = randomBelow(randomState, popcount16(left)); k > 0; --k) {
+    left &= left - 1;
+  }
+  int type = __builtin_ctz(left);
+  *bagLeft &= (uint8_t)~(1u << type);
+  return type;
+}
 
-  gs->tetrominoType = gs->nextTetrominoType;
-  gs->rotationIndex = 0;
+void generateNextTetromino(GameState* gs, int* type, int* rotationIndex) {
+  *type = dealTetromino(&gs->randomState, &gs->bagLeft, gs->randomizer);
+  *rotationIndex = 0;
+  gs->nextTetrominoType = *type;
+}
+
+bool hasNextTetromino(const GameState* gs) {
+  return gs->nextTetrominoType != kNoTetromino;
+}
 
-  bool collision = false;
-  const int(*shape)[kFigureSize] =
-      kTetrominoShapes[gs->tetrominoType][gs->rotationIndex];
-  for (int i = 0; i < kFigureSize && !collision; ++i) {
-    for (int j = 0; j < kFigureSize && !collision; ++j) {
-      if (shape[i][j]) {
-        int newX = j + *x;
-        int newY = i + *y;
-        if (newX >= 0 && newX < kCol && newY >= 0 && newY < kRow) {
-          if (gameInfo->field[newY][newX]) {
-            *state = kGameOver;
-            gameOverState(gameInfo);
-            collision = true;
-          }
-        }
+void syncFieldView(const GameState* gs, GameInfo* view) {
+  if (view->field) {
+    uint16_t rows[kRow];
+    memcpy(rows, gs->board, sizeof(rows));
+    overlayTetromino(gs, rows);
+    for (int i = 0; i < kRow; ++i) {
+      uint16_t row = rows[i];
+      for (int j = 0; j < kCol; ++j) {
+        view->field[i][j] = (row >> j) & 1;
       }
     }
   }
-  if (!collision) {
-    *currentTetromino =
-        spawnTetromino(gameInfo, *x, *y, gs->tetrominoType, gs->rotationIndex);
-    generateNextTetromino(gameInfo, &gs->nextTetrominoType, &gs->rotationIndex);
-    *state = kFalling;
+  if (view->next) {
+    for (int i = 0; i < kFigureSize; ++i) {
+      unsigned row = hasNextTetromino(gs)
+                         ? kPieceMasks[gs->nextTetrominoType][0].rows[i]
+                         : 0;
+      for (int j = 0; j < kFigureSize; ++j) {
+        view->next[i][j] = (row >> j) & 1;
+      }
+    }
   }
+  view->score = gs->stats.score;
+  view->high_score = gs->stats.high_score;
+  view->level = gs->stats.level;
+  view->speed = gs->stats.speed;
+  view->pause = gs->stats.pause;
 }
 
-void clearTetromino(GameInfo* gameInfo, TetrominoPoints* currentTetromino) {
-  for (int i = 0; i < kFigurePoints; ++i) {
-    int x = currentTetromino->points[i].x;
-    int y = currentTetromino->points[i].y;
-    if (x >= 0 && x < kCol && y >= 0 && y < kRow) {
-      gameInfo->field[y][x] = 0;
+void startGame(GameState* gs) {
+  GameStats* stats = &gs->stats;
+  memset(gs->board, 0, sizeof(gs->board));
+  memset(gs->columnHeights, 0, sizeof(gs->columnHeights));
+  gs->boardHash = 0;
+  gs->pieceActive = false;
+  gs->nextTetrominoType = kNoTetromino;
+  stats->score = 0;
+  stats->high_score = 0;
+  stats->level = 1;
+  stats->speed = kSpeed;
+  stats->pause = 0;
+  gs->pointsTowardLevel = 0;
+  gs->linesCleared = 0;
+
+  FILE* file = gs->persistHighScore ? fopen(kHighScorePath, "r") : NULL;
+  if (file) {
+    if (fscanf(file, "%d", &stats->high_score) != 1) {
+      stats->high_score = 0;
     }
+    fclose(file);
+  }
+}
+
+void spawnTetrominoState(GameState* gs, int* x, int* y, FsmState* state) {
+  if (!hasNextTetromino(gs)) {
+    generateNextTetromino(gs, &gs->nextTetrominoType, &gs->rotationIndex);
+  }
+
+  gs->tetrominoType = gs->nextTetrominoType;
+  gs->rotationIndex = 0;
+
+  const PieceMask* piece = &kPieceMasks[gs->tetrominoType][gs->rotationIndex];
+  *x = piece->spawnX;
+  *y = piece->spawnY;
+  bool collision =
+      !fits(gs, gs->tetrominoType, gs->rotationIndex, *x, *y);
+  if (collision) {
+    *state = kGameOver;
+    gameOverState(gs);
+  } else {
+    spawnTetromino(gs, *x, *y, gs->tetrominoType, gs->rotationIndex);
+    generateNextTetromino(gs, &gs->nextTetrominoType, &gs->rotationIndex);
+    *state = kFalling;
   }
 }
 
@@ -240,37 +474,27 @@ void getRotationOffsets(int tetrominoType, int offsets[][2], int* numOffsets) {
   }
 }
 
-bool isValidRotation(GameInfo* gameInfo, const int shape[][kFigureSize],
-                     int newX, int newY) {
-  for (int i = 0; i < kFigureSize; ++i) {
-    for (int j = 0; j < kFigureSize; ++j) {
-      if (shape[i][j]) {
-        int checkX = j + newX;
-        int checkY = i + newY;
-        if (checkX < 0 || checkX >= kCol || checkY < 0 || checkY >= kRow) {
-          return false;
-        }
-        if (gameInfo->field[checkY][checkX]) {
-          return false;
-        }
-      }
-    }
+bool fits(const GameState* gs, int type, int rotation, int x, int y) {
+  const PieceMask* piece = &kPieceMasks[type][rotation];
+  unsigned left = (unsigned)(x + piece->left);
+  unsigned top = (unsigned)(y + piece->top);
+  if (left > (unsigned)(kCol - piece->width) ||
+      top > (unsigned)(kRow - piece->height)) {
+    return false;
   }
-  return true;
+  uint16_t hit = 0;
+  for (int i = 0; i < piece->height; ++i) {
+    hit |= gs->board[top + i] & placeRow(piece->rows[piece->top + i], x);
+  }
+  return hit == 0;
 }
 
-void applyRotation(GameInfo* gameInfo, TetrominoPoints* currentTetromino,
-                   int tetrominoType, int nextRotation, int newX, int newY,
-                   GameState* gs) {
-  gs->rotationIndex = nextRotation;
-  gs->tetrominoX = newX;
-  gs->tetrominoY = newY;
-  *currentTetromino =
-      spawnTetromino(gameInfo, newX, newY, tetrominoType, nextRotation);
+void applyRotation(GameState* gs, int tetrominoType, int nextRotation,
+                   int newX, int newY) {
+  spawnTetromino(gs, newX, newY, tetrominoType, nextRotation);
 }
 
-void rotateTetromino(GameInfo* gameInfo, TetrominoPoints* currentTetromino) {
-  GameState* gs = getGameState();
+void rotateTetromino(GameState* gs) {
   const int* rotations = getRotationsPerTetromino();
   int tetrominoType = gs->tetrominoType;
   int currentRotation = gs->rotationIndex;
@@ -281,10 +505,7 @@ void rotateTetromino(GameInfo* gameInfo, TetrominoPoints* currentTetromino) {
   }
 
   int nextRotation = (currentRotation + 1) % numRotations;
-  const int(*shape)[kFigureSize] =
-      kTetrominoShapes[tetrominoType][nextRotation];
 
-  clearTetromino(gameInfo, currentTetromino);
   int offsets[7][2];
   int numOffsets;
   getRotationOffsets(tetrominoType, offsets, &numOffsets);
@@ -293,253 +514,125 @@ void rotateTetromino(GameInfo* gameInfo, TetrominoPoints* currentTetromino) {
   for (int k = 0; k < numOffsets && !rotated; ++k) {
     int newX = gs->tetrominoX + offsets[k][0];
     int newY = gs->tetrominoY + offsets[k][1];
-    if (isValidRotation(gameInfo, shape, newX, newY)) {
-      applyRotation(gameInfo, currentTetromino, tetrominoType, nextRotation,
-                    newX, newY, gs);
+    if (fits(gs, tetrominoType, nextRotation, newX, newY)) {
+      applyRotation(gs, tetrominoType, nextRotation, newX, newY);
       rotated = true;
     }
   }
-  if (!rotated) {
-    for (int i = 0; i < kFigurePoints; ++i) {
-      int x = currentTetromino->points[i].x;
-      int y = currentTetromino->points[i].y;
-      if (x >= 0 && x < kCol && y >= 0 && y < kRow) {
-        gameInfo->field[y][x] = 1;
-      }
-    }
-  }
-}
-
-void getLowestPoints(TetrominoPoints* currentTetromino, int lowestY[]) {
-  for (int i = 0; i < kCol; ++i) {
-    lowestY[i] = -1;
-  }
-  for (int i = 0; i < kFigurePoints; ++i) {
-    int x = currentTetromino->points[i].x;
-    int y = currentTetromino->points[i].y;
-    if (x >= 0 && x < kCol && y >= 0 && y < kRow) {
-      if (lowestY[x] == -1 || y > lowestY[x]) {
-        lowestY[x] = y;
-      }
-    }
-  }
-}
-
-bool canMoveDown(GameInfo* gameInfo, int lowestY[]) {
-  for (int x = 0; x < kCol; ++x) {
-    if (lowestY[x] != -1) {
-      int newY = lowestY[x] + 1;
-      if (newY >= kRow ||
-          (newY >= 0 && newY < kRow && gameInfo->field[newY][x])) {
-        return false;
-      }
-    }
-  }
-  return true;
-}
-
-void moveTetrominoDown(GameInfo* gameInfo, TetrominoPoints* currentTetromino) {
-  // Очистить текущую позицию
-  for (int i = 0; i < kFigurePoints; ++i) {
-    int x = currentTetromino->points[i].x;
-    int y = currentTetromino->points[i].y;
-    if (x >= 0 && x < kCol && y >= 0 && y < kRow) {
-      gameInfo->field[y][x] = 0;
-    }
-  }
-  // Обновить координаты
-  for (int i = 0; i < kFigurePoints; ++i) {
-    if (currentTetromino->points[i].x >= 0) {
-      currentTetromino->points[i].y++;
-    }
-  }
-  // Перерисовать тетромино
-  for (int i = 0; i < kFigurePoints; ++i) {
-    int x = currentTetromino->points[i].x;
-    int y = currentTetromino->points[i].y;
-    if (x >= 0 && x < kCol && y >= 0 && y < kRow) {
-      gameInfo->field[y][x] = 1;
-    }
-  }
 }
 
-void updateTetrominoY(TetrominoPoints* currentTetromino, GameState* gs) {
-  int minY = kRow;
-  for (int i = 0; i < kFigurePoints; ++i) {
-    if (currentTetromino->points[i].y >= 0 &&
-        currentTetromino->points[i].y < minY) {
-      minY = currentTetromino->points[i].y;
-    }
+void fallingTetrominoState(GameState* gs, FsmState* state) {
+  // Снятие паузы между фиксацией и появлением новой фигуры: падать нечему,
+  // поэтому продолжаем с очистки линий.
+  if (!gs->pieceActive) {
+    *state = kClearing;
+    return;
   }
-  gs->tetrominoY = minY;
-}
-
-void fallingTetrominoState(GameInfo* gameInfo,
-                           TetrominoPoints* currentTetromino, FsmState* state) {
-  GameState* gs = getGameState();
-  int lowestY[kCol];
-  getLowestPoints(currentTetromino, lowestY);
-  if (canMoveDown(gameInfo, lowestY)) {
-    moveTetrominoDown(gameInfo, currentTetromino);
-    updateTetrominoY(currentTetromino, gs);
+  if (fits(gs, gs->tetrominoType, gs->rotationIndex, gs->tetrominoX,
+           gs->tetrominoY + 1)) {
+    gs->tetrominoY++;
   } else {
     *state = kLocking;
   }
 }
 
-void getExtremePoints(TetrominoPoints* currentTetromino, UserAction direction,
-                      int extremeX[], int pointsPerY[]) {
-  for (int i = 0; i < kRow; ++i) {
-    extremeX[i] = (direction == kActionLeft) ? kCol : -1;
-    pointsPerY[i] = 0;
-  }
-  for (int i = 0; i < kFigurePoints; ++i) {
-    int x = currentTetromino->points[i].x;
-    int y = currentTetromino->points[i].y;
-    if (y >= 0 && y < kRow) {
-      pointsPerY[y]++;
-      if (direction == kActionLeft) {
-        if (x < extremeX[y]) {
-          extremeX[y] = x;
-        }
-      } else {
-        if (x > extremeX[y]) {
-          extremeX[y] = x;
-        }
-      }
-    }
-  }
-}
-
-bool canMoveSideways(GameInfo* gameInfo, int extremeX[], int pointsPerY[],
-                     int deltaX) {
-  for (int y = 0; y < kRow; ++y) {
-    if (pointsPerY[y] > 0) {
-      int checkX = extremeX[y] + deltaX;
-      if (y < 0 || y >= kRow || checkX < 0 || checkX >= kCol ||
-          gameInfo->field[y][checkX]) {
-        return false;
-      }
-    }
-  }
-  return true;
-}
-
-void shiftTetromino(GameInfo* gameInfo, TetrominoPoints* currentTetromino,
-                    int deltaX) {
-  for (int i = 0; i < kFigurePoints; ++i) {
-    int x = currentTetromino->points[i].x;
-    int y = currentTetromino->points[i].y;
-    if (x >= 0 && x < kCol && y >= 0 && y < kRow) {
-      gameInfo->field[y][x] = 0;
-    }
-  }
-  for (int i = 0; i < kFigurePoints; ++i) {
-    if (currentTetromino->points[i].x >= 0) {
-      currentTetromino->points[i].x += deltaX;
-    }
-  }
-  for (int i = 0; i < kFigurePoints; ++i) {
-    int x = currentTetromino->points[i].x;
-    int y = currentTetromino->points[i].y;
-    if (x >= 0 && x < kCol && y >= 0 && y < kRow) {
-      gameInfo->field[y][x] = 1;
-    }
+bool shiftTetromino(GameState* gs, UserAction direction) {
+  int deltaX = (direction == kActionLeft) ? -1 : 1;
+  bool moved = fits(gs, gs->tetrominoType, gs->rotationIndex,
+                    gs->tetrominoX + deltaX, gs->tetrominoY);
+  if (moved) {
+    gs->tetrominoX += deltaX;
+    updateGhost(gs);
   }
+  return moved;
 }
 
-void movingTetrominoState(GameInfo* gameInfo, TetrominoPoints* currentTetromino,
-                          FsmState* state, int* x, UserAction direction) {
+void movingTetrominoState(GameState* gs, FsmState* state, int* x,
+                          UserAction direction) {
   int deltaX = (direction == kActionLeft) ? -1 : 1;
-  int extremeX[kRow];
-  int pointsPerY[kRow];
+  int type = gs->tetrominoType;
+  int rotation = gs->rotationIndex;
 
   // Сначала попытаться выполнить боковое смещение
-  getExtremePoints(currentTetromino, direction, extremeX, pointsPerY);
-  if (canMoveSideways(gameInfo, extremeX, pointsPerY, deltaX)) {
-    shiftTetromino(gameInfo, currentTetromino, deltaX);
+  if (fits(gs, type, rotation, *x + deltaX, gs->tetrominoY)) {
     *x += deltaX;
+    updateGhost(gs);
   }
-
   // Затем выполнить один цикл падения
-  fallingTetrominoState(gameInfo, currentTetromino, state);
-
-  // Сохранить kFalling, если не kLocking
-  if (*state != kLocking) {
+  if (fits(gs, type, rotation, *x, gs->tetrominoY + 1)) {
+    gs->tetrominoY++;
     *state = kFalling;
+  } else {
+    *state = kLocking;
   }
 }
 
-void clearLinesState(GameInfo* gameInfo, FsmState* state) {
-  GameState* gs = getGameState();
-  int linesCleared = 0;
-  for (int y = kRow - 1; y >= 0 && linesCleared < 4; --y) {
-    bool lineFull = true;
-    for (int x = 0; x < kCol; ++x) {
-      if (!gameInfo->field[y][x]) {
-        lineFull = false;
-        break;
-      }
-    }
-    if (lineFull) {
-      linesCleared++;
-      for (int yy = y; yy > 0; --yy) {
-        for (int x = 0; x < kCol; ++x) {
-          gameInfo->field[yy][x] = gameInfo->field[yy - 1][x];
-        }
-      }
-      for (int x = 0; x < kCol; ++x) {
-        gameInfo->field[0][x] = 0;
-      }
-      y++;
+void scoreLines(int lines, int* score, int* level, int* pointsTowardLevel) {
+  static const int kPoints[] = {0, kScoreSingleLine, kScoreDoubleLine,
+                                kScoreTripleLine, kScoreTetris};
+  int points = lines >= 0 && lines <= 4 ? kPoints[lines] : 0;
+  *score += points;
+  *pointsTowardLevel += points;
+  while (*pointsTowardLevel >= kPointsPerLevel && *level < kMaxLevel) {
+    ++*level;
+    *pointsTowardLevel -= kPointsPerLevel;
+  }
+}
+
+void clearLinesState(GameState* gs, FsmState* state) {
+  GameStats* stats = &gs->stats;
+  // Один проход снизу вверх: незаполненные строки сдвигаются вниз поверх
+  // заполненных, освободившиеся строки сверху обнуляются. Хеш меняется
+  // только для удалённых и сдвинутых строк.
+  int write = kRow - 1;
+  uint64_t hash = gs->boardHash;
+  for (int read = kRow - 1; read >= 0; --read) {
+    uint16_t row = gs->board[read];
+    gs->board[write] = row;
+    if (row == kFullRow) {
+      hash ^= zobristRow(read, row);
+    } else if (write != read) {
+      hash ^= zobristRow(read, row) ^ zobristRow(write, row);
     }
+    write -= (row != kFullRow);
   }
+  gs->boardHash = hash;
+  int linesCleared = write + 1;
+  memset(gs->board, 0, linesCleared * sizeof(gs->board[0]));
+  gs->linesCleared += linesCleared;
 
   if (linesCleared > 0) {
-    int points = 0;
-    switch (linesCleared) {
-      case 1:
-        points = kScoreSingleLine;
-        break;
-      case 2:
-        points = kScoreDoubleLine;
-        break;
-      case 3:
-        points = kScoreTripleLine;
-        break;
-      case 4:
-        points = kScoreTetris;
-        break;
-    }
-    gameInfo->score += points;
-    gs->pointsTowardLevel += points;
-
-    while (gs->pointsTowardLevel >= kPointsPerLevel &&
-           gameInfo->level < kMaxLevel) {
-      gameInfo->level++;
-      gs->pointsTowardLevel -= kPointsPerLevel;
-      gameInfo->speed = kSpeed - (gameInfo->level - 1) * 100;
-      if (gameInfo->speed < kMinSpeed) {
-        gameInfo->speed = kMinSpeed;
+    rebuildColumnHeights(gs);
+    int level = stats->level;
+    scoreLines(linesCleared, &stats->score, &stats->level,
+               &gs->pointsTowardLevel);
+    if (stats->level != level) {
+      stats->speed = kSpeed - (stats->level - 1) * 100;
+      if (stats->speed < kMinSpeed) {
+        stats->speed = kMinSpeed;
       }
     }
 
-    if (gameInfo->score > gameInfo->high_score) {
-      gameInfo->high_score = gameInfo->score;
+    if (stats->score > stats->high_score) {
+      stats->high_score = stats->score;
     }
   }
 
   *state = kSpawn;
 }
 
-void gameOverState(GameInfo* gameInfo) {
-  gameInfo->pause = -1;
-  if (gameInfo->score > gameInfo->high_score) {
-    gameInfo->high_score = gameInfo->score;
+void gameOverState(GameState* gs) {
+  GameStats* stats = &gs->stats;
+  stats->pause = -1;
+  if (stats->score > stats->high_score) {
+    stats->high_score = stats->score;
+  }
+  if (!gs->persistHighScore) {
+    return;
   }
   FILE* file = fopen(kHighScorePath, "w");
   if (file) {
-    fprintf(file, "%d", gameInfo->high_score);
+    fprintf(file, "%d", stats->high_score);
     fclose(file);
   } else {
     fprintf(stderr, "Failed to write high score to %s\n", kHighScorePath);
@@ -547,12 +640,24 @@ void gameOverState(GameInfo* gameInfo) {
 }
 
 void userInput(UserAction action, bool hold) {
-  GameState* gs = getGameState();
-  GameInfo* info = &gs->gameInfo;
+  tetris_userInput(getDefaultGame(), action, hold);
+}
+
+/**
+ * Applies one user action to a game instance.
+ * @param game The game instance.
+ * @param action The user action.
+ * @param hold Whether the action is held.
+ */
+static void applyUserInput(TetrisGame* game, UserAction action, bool hold) {
+  GameState* gs = &game->state;
+  GameStats* info = &gs->stats;
+  // Удержание и одиночное нажатие вниз сбрасывают фигуру одинаково.
+  (void)hold;
   switch (action) {
     case kActionStart:
       if (gs->state == kStart) {
-        startGame(info);
+        startGame(gs);
         gs->state = kSpawn;
       }
       break;
@@ -567,8 +672,8 @@ void userInput(UserAction action, bool hold) {
       break;
     case kActionTerminate:
       gs->state = kGameOver;
-      gameOverState(info);
-      cleanupGame();
+      gameOverState(gs);
+      cleanupGame(game);
       break;
     case kActionLeft:
     case kActionRight:
@@ -582,57 +687,147 @@ void userInput(UserAction action, bool hold) {
     case kActionDown:
       if (!info->pause && (gs->state == kFalling || gs->state == kMoving)) {
         gs->state = kFalling;
-        if (hold) {
-          fallingTetrominoState(info, &gs->currentTetromino, &gs->state);
-        }
-        while (gs->state == kFalling) {
-          fallingTetrominoState(info, &gs->currentTetromino, &gs->state);
-        }
+        hardDropState(gs, &gs->state);
       }
       break;
     case kActionRotate:
       if (!info->pause && gs->state == kFalling) {
         gs->state = kRotating;
-        rotateTetromino(info, &gs->currentTetromino);
+        rotateTetromino(gs);
         gs->state = kFalling;
       }
       break;
   }
 }
 
+void tetris_userInput(TetrisGame* game, UserAction action, bool hold) {
+  // После конца игры ввод ничего не меняет и в журнал не пишется.
+  if (game->recorder && game->state.state != kGameOver) {
+    replayRecordInput(game->recorder, action, hold, false);
+  }
+  applyUserInput(game, action, hold);
+}
+
+void userInputBatch(const UserAction* actions, const bool* hold, int n) {
+  tetris_userInputBatch(getDefaultGame(), actions, hold, n);
+}
+
+/**
+ * Applies a pending sideways move without the gravity step that
+ * movingTetrominoState() adds, and returns the piece to kFalling.
+ * @param gs Pointer to the game state.
+ */
+static void applyPendingShift(GameState* gs) {
+  shiftTetromino(gs, gs->moveDirection);
+  gs->state = kFalling;
+}
+
+void tetris_userInputBatch(TetrisGame* game, const UserAction* actions,
+                           const bool* hold, int n) {
+  GameState* gs = &game->state;
+  for (int i = 0; i < n; ++i) {
+    // Отложенный сдвиг предыдущего действия применяется сразу, чтобы
+    // следующее действие пакета не было отброшено в состоянии kMoving.
+    bool held = hold ? hold[i] : false;
+    if (game->recorder && gs->state != kGameOver) {
+      replayRecordInput(game->recorder, actions[i], held, true);
+    }
+    if (gs->state == kMoving) {
+      applyPendingShift(gs);
+    }
+    applyUserInput(game, actions[i], held);
+  }
+}
+
+bool tetris_applyPendingShift(TetrisGame* game) {
+  GameState* gs = &game->state;
+  bool pending = gs->state == kMoving;
+  if (pending) {
+    applyPendingShift(gs);
+  }
+  return pending;
+}
+
 GameInfo updateCurrentState() {
-  GameState* gs = getGameState();
-  GameInfo* info = &gs->gameInfo;
+  return tetris_updateCurrentState(getDefaultGame());
+}
+
+GameInfo tetris_updateCurrentState(TetrisGame* game) {
+  tetris_tick(game);
+  GameInfo* view = &game->view;
+  if (!view->field) {
+    view->field = allocMatrix(kRow, kCol);
+  }
+  if (!view->next) {
+    view->next = allocMatrix(kFigureSize, kFigureSize);
+  }
+  syncFieldView(&game->state, view);
+  tetris_publishFrame(game);
+  return *view;
+}
+
+const TetrisFrame* tetris_publishFrame(TetrisGame* game) {
+  const GameState* gs = &game->state;
+  const GameStats* stats = &gs->stats;
+  unsigned front = atomic_load_explicit(&game->front, memory_order_relaxed);
+  TetrisFrame* frame = &game->frames[front ^ 1];
+  frame->seq = game->frames[front].seq + 1;
+  memcpy(frame->field, gs->board, sizeof(frame->field));
+  overlayTetromino(gs, frame->field);
+  overlayGhost(gs, frame->field, frame->ghost);
+  for (int i = 0; i < kFigureSize; ++i) {
+    frame->next[i] = hasNextTetromino(gs)
+                         ? kPieceMasks[gs->nextTetrominoType][0].rows[i]
+                         : 0;
+  }
+  frame->score = stats->score;
+  frame->highScore = stats->high_score;
+  frame->level = stats->level;
+  frame->speed = stats->speed;
+  frame->pause = stats->pause;
+  atomic_store_explicit(&game->front, front ^ 1, memory_order_release);
+  return frame;
+}
+
+const TetrisFrame* tetris_currentFrame(TetrisGame* game) {
+  return &game->frames[atomic_load_explicit(&game->front,
+                                            memory_order_acquire)];
+}
+
+void tetris_tick(TetrisGame* game) {
+  GameState* gs = &game->state;
+  GameStats* info = &gs->stats;
   if (!info->pause && gs->state != kGameOver) {
     switch (gs->state) {
       case kSpawn:
-        spawnTetrominoState(info, &gs->currentTetromino, &gs->tetrominoX,
-                            &gs->tetrominoY, &gs->state);
+        spawnTetrominoState(gs, &gs->tetrominoX, &gs->tetrominoY, &gs->state);
         break;
       case kFalling:
-        fallingTetrominoState(info, &gs->currentTetromino, &gs->state);
+        fallingTetrominoState(gs, &gs->state);
         break;
       case kMoving:
-        movingTetrominoState(info, &gs->currentTetromino, &gs->state,
-                             &gs->tetrominoX, gs->moveDirection);
+        movingTetrominoState(gs, &gs->state, &gs->tetrominoX,
+                             gs->moveDirection);
         break;
       case kLocking:
+        lockTetromino(gs);
         gs->state = kClearing;
         break;
       case kClearing:
-        clearLinesState(info, &gs->state);
+        clearLinesState(gs, &gs->state);
         break;
       default:
         break;
     }
   }
-  return *info;
+  if (game->recorder) {
+    replayRecordTick(game->recorder, gs);
+  }
 }
 
-void cleanupGame() {
-  GameState* gs = getGameState();
-  freeMatrix(gs->gameInfo.field, kRow);
-  freeMatrix(gs->gameInfo.next, kFigureSize);
-  gs->gameInfo.field = NULL;
-  gs->gameInfo.next = NULL;
+void cleanupGame(TetrisGame* game) {
+  freeMatrix(game->view.field, kRow);
+  freeMatrix(game->view.next, kFigureSize);
+  game->view.field = NULL;
+  game->view.next = NULL;
 }
\ No newline at end of file
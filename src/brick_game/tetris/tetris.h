@@ -1,15 +1,22 @@
 #ifndef TETRIS_TETRIS_H_
 #define TETRIS_TETRIS_H_
 
-#include <ncurses.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
+// Field height; override with -DTETRIS_ROWS=N for tall stress boards.
+#ifndef TETRIS_ROWS
+#define TETRIS_ROWS 20
+#endif
+
 // Constants for game field dimensions and settings.
 enum {
-  kRow = 20,               // Number of rows in the game field.
+  kRow = TETRIS_ROWS,      // Number of rows in the game field.
   kCol = 10,               // Number of columns in the game field.
   kFigureSize = 4,         // Size of tetromino matrix.
   kFigurePoints = 4,       // Number of points in a tetromino.
@@ -23,6 +30,34 @@ enum {
   kMinSpeed = 100          // Minimum speed (ms).
 };
 
+// Column heights and the replay header store kRow in one byte, and the
+// 4x4 grid of a tetromino spawns at the top row, so it must fit below.
+_Static_assert(kRow <= 255, "TETRIS_ROWS must be at most 255");
+_Static_assert(kRow >= kFigureSize, "TETRIS_ROWS must be at least 4");
+
+// Bitboard row mask with every column occupied.
+enum { kFullRow = (1 << kCol) - 1 };
+
+/**
+ * Counts the set bits of a row or bag mask. The masks fit in 16 bits, and
+ * this SWAR sum avoids the libgcc call __builtin_popcount() makes on
+ * targets without a popcount instruction.
+ * @param v The mask (bits 0–15).
+ * @return Number of set bits.
+ */
+static inline int popcount16(unsigned v) {
+  v -= (v >> 1) & 0x5555;
+  v = (v & 0x3333) + ((v >> 2) & 0x3333);
+  v = (v + (v >> 4)) & 0x0F0F;
+  return (int)((v + (v >> 8)) & 0x1F);
+}
+
+// Marks an empty next slot in GameState.nextTetrominoType.
+enum { kNoTetromino = -1 };
+
+// Number of tetromino types (I, L, O, T, S, Z, J).
+enum { kTetrominoTypes = 7 };
+
 // Path to the high score file (defined in tetris.c).
 extern const char* kHighScorePath;
 
@@ -51,18 +86,16 @@ typedef enum {
   kActionRotate      // Rotate tetromino.
 } UserAction;
 
-// Represents a single point of a tetromino.
-typedef struct {
-  int x;  // X-coordinate.
-  int y;  // Y-coordinate.
-} Point;
-
-// Stores the points of the current tetromino.
-typedef struct {
-  Point points[kFigurePoints];  // Array of points.
-} TetrominoPoints;
-
-// Game state information for rendering.
+// Ways of dealing the next tetromino.
+typedef enum {
+  kRandomizerUniform,  // Every type is equally likely on every draw.
+  kRandomizerBag       // Each run of 7 pieces holds every type once.
+} PieceRandomizer;
+
+// Game state information for rendering. The field is a view of the
+// engine's bitboard with the falling tetromino composited on top,
+// refreshed by updateCurrentState(). The matrices belong to the game
+// instance, not to GameState.
 typedef struct {
   int** field;     // Game field.
   int** next;      // Next tetromino.
@@ -73,42 +106,234 @@ typedef struct {
   int pause;       // Pause flag.
 } GameInfo;
 
-// Internal game state.
+// Scalar part of GameInfo kept by the engine.
 typedef struct {
-  FsmState state;            // Current state of the finite state machine.
-  int tetrominoX;            // X-coordinate of the tetromino.
-  int tetrominoY;            // Y-coordinate of the tetromino.
-  int tetrominoType;         // Type of the current tetromino.
-  int nextTetrominoType;     // Type of the next tetromino.
-  int rotationIndex;         // Rotation index.
-  UserAction moveDirection;  // Movement direction.
-  TetrominoPoints currentTetromino;  // Current tetromino.
-  GameInfo gameInfo;                 // Game information.
-  int pointsTowardLevel;             // Points toward the next level.
+  int score;       // Current score.
+  int high_score;  // High score.
+  int level;       // Current level.
+  int speed;       // Game speed (ms).
+  int pause;       // Pause flag.
+} GameStats;
+
+// Internal game state. The falling tetromino is kept as (type, rotation,
+// x, y) outside the board and only merged into it when it locks. The
+// state holds no pointers, so a plain copy of it is a complete snapshot.
+typedef struct {
+  FsmState state;               // Current state of the finite state machine.
+  int tetrominoX;               // X-coordinate of the tetromino.
+  int tetrominoY;               // Y-coordinate of the tetromino.
+  int tetrominoType;            // Type of the current tetromino.
+  int nextTetrominoType;        // Type of the next tetromino or kNoTetromino.
+  int rotationIndex;            // Rotation index.
+  UserAction moveDirection;     // Movement direction.
+  bool pieceActive;             // The falling tetromino is in play.
+  int ghostY;                   // Cached landing row of the tetromino.
+  GameStats stats;              // Score, level, speed and pause flag.
+  int pointsTowardLevel;        // Points toward the next level.
+  uint16_t board[kRow];         // Locked cells, bit x of row y is (x, y).
+  uint8_t columnHeights[kCol];  // Surface height per column, 0 if empty.
+  uint64_t boardHash;           // Zobrist hash of the board.
+  int linesCleared;             // Lines cleared since the game start.
+  uint64_t randomState;         // PCG32 state of the piece generator.
+  PieceRandomizer randomizer;   // How the next tetromino is picked.
+  uint8_t bagLeft;              // Types left in the 7-bag, bit per type.
+  bool persistHighScore;        // Read and write kHighScorePath.
 } GameState;
 
+// Immutable snapshot of a game for frontends. Frames are published into
+// a double buffer, so a published frame stays unchanged until the second
+// publish after it.
+typedef struct {
+  uint64_t seq;               // Frame sequence number, 1 for the first.
+  uint16_t field[kRow];       // Field rows, bit x of row y is (x, y).
+  uint16_t ghost[kRow];       // Ghost piece cells not covered by field.
+  uint8_t next[kFigureSize];  // Next tetromino rows, bit j is column j.
+  int score;                  // Current score.
+  int highScore;              // High score.
+  int level;                  // Current level.
+  int speed;                  // Game speed (ms).
+  int pause;                  // Pause flag.
+} TetrisFrame;
+
+// Independent game instance. Every instance owns its whole state, so
+// several games can run side by side in one process.
+typedef struct TetrisGame {
+  GameState state;                  // Engine state.
+  GameInfo view;                    // Matrix view for updateCurrentState().
+  TetrisFrame frames[2];            // Front and back snapshot buffers.
+  atomic_uint front;                // Index of the last published frame.
+  struct TetrisRecorder* recorder;  // Replay recorder, or NULL.
+} TetrisGame;
+
+// Fixed-size snapshot of a game instance for search and rollback. It is
+// plain data: copy it, store it in arrays or write it to disk as is.
+typedef struct {
+  GameState state;  // Engine state at the time of the save.
+} TetrisSnapshot;
+
 // Tetromino shapes with rotations (I, L, O, T, S, Z, J).
 extern const int kTetrominoShapes[][4][kFigureSize][kFigureSize];
 
-/**
- * Initializes and runs the Tetris game.
- * @return 0 on successful termination, non-zero on error.
- */
-int runTetris();
+// Packed form of one tetromino rotation. Coordinates are relative to the
+// 4x4 shape grid; skirt entries are -1 for empty rows or columns.
+typedef struct {
+  uint8_t rows[kFigureSize];        // Row masks, bit j is grid column j.
+  int8_t left;                      // First occupied grid column.
+  int8_t top;                       // First occupied grid row.
+  int8_t width;                     // Bounding box width.
+  int8_t height;                    // Bounding box height.
+  int8_t leftSkirt[kFigureSize];    // Leftmost occupied column per row.
+  int8_t rightSkirt[kFigureSize];   // Rightmost occupied column per row.
+  int8_t bottomSkirt[kFigureSize];  // Lowest occupied row per column.
+  int8_t spawnX;                    // Grid x-coordinate at spawn.
+  int8_t spawnY;                    // Grid y-coordinate at spawn.
+} PieceMask;
+
+// Piece masks indexed by tetromino type and rotation, generated from
+// kTetrominoShapes. Rotations past getRotationsPerTetromino() are zeroed.
+extern const PieceMask kPieceMasks[][4];
 
 /**
- * Processes user input to control the game.
+ * Processes user input to control the default game instance.
  * @param action The user action (e.g., move left, pause).
  * @param hold Whether the action is held (for continuous movement).
  */
 void userInput(UserAction action, bool hold);
 
 /**
- * Updates the game state and returns the current state for rendering.
+ * Applies a batch of user actions to the default game instance.
+ * @param actions The actions, in the order they were received.
+ * @param hold Hold flag for each action, or NULL if none is held.
+ * @param n Number of actions.
+ */
+void userInputBatch(const UserAction* actions, const bool* hold, int n);
+
+/**
+ * Updates the default game instance and returns its state for rendering.
  * @return The current game state.
  */
 GameInfo updateCurrentState();
 
+/**
+ * Allocates a new game instance in the kStart state. The instance does
+ * not touch the high score file unless persistHighScore is set.
+ * @return Pointer to the instance, or NULL on failure.
+ */
+TetrisGame* tetris_create(void);
+
+/**
+ * Frees a game instance created by tetris_create().
+ * @param game The game instance (may be NULL).
+ */
+void tetris_destroy(TetrisGame* game);
+
+/**
+ * Processes user input for the given game instance.
+ * @param game The game instance.
+ * @param action The user action (e.g., move left, pause).
+ * @param hold Whether the action is held (for continuous movement).
+ */
+void tetris_userInput(TetrisGame* game, UserAction action, bool hold);
+
+/**
+ * Applies a batch of user actions in one pass. Each action sees the state
+ * left by the previous one: a sideways move that would otherwise wait for
+ * the next update is applied as a plain shift when another action
+ * follows it. Only the last move of the batch stays pending, so a batch
+ * of one behaves exactly like tetris_userInput().
+ * @param game The game instance.
+ * @param actions The actions, in the order they were received.
+ * @param hold Hold flag for each action, or NULL if none is held.
+ * @param n Number of actions.
+ */
+void tetris_userInputBatch(TetrisGame* game, const UserAction* actions,
+                           const bool* hold, int n);
+
+/**
+ * Applies the sideways move left pending by the last action as a plain
+ * shift, without the gravity step the next update would add. Nothing is
+ * recorded: a replay applies the same shift at the next batched action or
+ * tick, so the outcome matches as long as the inputs in between come
+ * through tetris_userInputBatch().
+ * @param game The game instance.
+ * @return True if a move was pending.
+ */
+bool tetris_applyPendingShift(TetrisGame* game);
+
+/**
+ * Updates the given game instance, publishes a frame and returns its state
+ * for rendering.
+ * @param game The game instance.
+ * @return The current game state.
+ */
+GameInfo tetris_updateCurrentState(TetrisGame* game);
+
+/**
+ * Advances the given game instance by one tick without refreshing the
+ * GameInfo view. Meant for headless drivers.
+ * @param game The game instance.
+ */
+void tetris_tick(TetrisGame* game);
+
+/**
+ * Saves the complete engine state of a game instance (FSM state, pieces,
+ * board, score, level and piece generator) with a single copy.
+ * @param game The game instance.
+ * @param snapshot Pointer to receive the snapshot.
+ */
+void tetris_save(const TetrisGame* game, TetrisSnapshot* snapshot);
+
+/**
+ * Restores a snapshot taken by tetris_save(), possibly from another
+ * instance. The game continues exactly as it would have from the save.
+ * Frames and the GameInfo view are refreshed on the next update, and an
+ * attached replay recorder is not rewound. The instance keeps its own
+ * persistHighScore setting.
+ * @param game The game instance.
+ * @param snapshot The snapshot to load.
+ */
+void tetris_restore(TetrisGame* game, const TetrisSnapshot* snapshot);
+
+/**
+ * Seeds the piece generator of the given game instance. Two instances with
+ * the same seed and randomizer deal the same pieces.
+ * @param game The game instance.
+ * @param seed The seed.
+ */
+void tetris_seed(TetrisGame* game, uint64_t seed);
+
+/**
+ * Selects how the given game instance deals pieces and starts a new bag.
+ * @param game The game instance.
+ * @param randomizer The randomizer to use.
+ */
+void tetris_setRandomizer(TetrisGame* game, PieceRandomizer randomizer);
+
+/**
+ * Advances a PCG32 generator. Any state, including 0, is valid.
+ * @param state Pointer to the generator state.
+ * @return The next 32 random bits.
+ */
+uint32_t randomNext(uint64_t* state);
+
+/**
+ * Publishes a snapshot of the given game instance. The frame is written
+ * into the back buffer and then made current, so the frame returned by
+ * the previous call stays valid and unchanged until the next call.
+ * @param game The game instance.
+ * @return Pointer to the published frame.
+ */
+const TetrisFrame* tetris_publishFrame(TetrisGame* game);
+
+/**
+ * Returns the last published frame without copying. Safe to call from
+ * another thread than the one publishing, provided the reader is done with
+ * the frame before the publisher calls tetris_publishFrame() twice more.
+ * @param game The game instance.
+ * @return Pointer to the current frame (seq is 0 if none was published).
+ */
+const TetrisFrame* tetris_currentFrame(TetrisGame* game);
+
 /**
  * Returns the number of rotations per tetromino type (I, L, O, T, S, Z, J).
  * @return Pointer to an array of rotation counts.
@@ -116,8 +341,14 @@ GameInfo updateCurrentState();
 const int* getRotationsPerTetromino();
 
 /**
- * Returns the singleton game state. Not thread-safe.
- * @return Pointer to the global GameState instance.
+ * Returns the game instance behind userInput() and updateCurrentState().
+ * @return Pointer to the default TetrisGame instance.
+ */
+TetrisGame* getDefaultGame();
+
+/**
+ * Returns the state of the default game instance. Not thread-safe.
+ * @return Pointer to the default GameState.
  */
 GameState* getGameState();
 
@@ -137,106 +368,206 @@ int** allocMatrix(int rows, int cols);
 void freeMatrix(int** matrix, int rows);
 
 /**
- * Spawns a new tetromino on the game field.
- * @param gameInfo Pointer to the game information structure.
+ * Makes the given tetromino the falling piece. The board is not touched.
+ * @param gs Pointer to the game state.
  * @param x X-coordinate of the tetromino’s top-left corner.
  * @param y Y-coordinate of the tetromino’s top-left corner.
  * @param type Type of tetromino (0–6 for I, L, O, T, S, Z, J).
  * @param rotationIndex Rotation index of the tetromino.
- * @return TetrominoPoints structure with the tetromino’s coordinates.
  */
-TetrominoPoints spawnTetromino(GameInfo* gameInfo, int x, int y, int type,
-                               int rotationIndex);
+void spawnTetromino(GameState* gs, int x, int y, int type, int rotationIndex);
+
+/**
+ * Composites the falling tetromino, if any, onto a copy of the board.
+ * @param gs Pointer to the game state.
+ * @param rows Field rows to draw the piece into (kRow entries).
+ */
+void overlayTetromino(const GameState* gs, uint16_t* rows);
+
+/**
+ * Draws the ghost piece (the falling tetromino at its cached landing row)
+ * into a separate layer, leaving out cells already set in the field.
+ * @param gs Pointer to the game state.
+ * @param field Composited field rows (kRow entries).
+ * @param ghost Rows to receive the ghost (kRow entries, overwritten).
+ */
+void overlayGhost(const GameState* gs, const uint16_t* field,
+                  uint16_t* ghost);
+
+/**
+ * Merges the falling tetromino into the board and ends its fall. Column
+ * heights are raised to cover the locked cells.
+ * @param gs Pointer to the game state.
+ */
+void lockTetromino(GameState* gs);
+
+/**
+ * Recomputes the column heights from the board in one sweep from the top.
+ * Needed after line clears and after editing the board directly.
+ * @param gs Pointer to the game state.
+ */
+void rebuildColumnHeights(GameState* gs);
+
+/**
+ * Returns the Zobrist key of a board row: a fixed random 64-bit value for
+ * every (row index, row contents) pair, 0 for an empty row. The hash of a
+ * board is the XOR of the keys of its rows, so changing one row costs two
+ * keys. Keys are derived with splitmix64 instead of stored in a table.
+ * @param y Row index.
+ * @param row Row contents, bit x for column x.
+ * @return The key.
+ */
+uint64_t zobristRow(int y, uint16_t row);
+
+/**
+ * Computes the Zobrist hash of a board from scratch. lockTetromino() and
+ * clearLinesState() keep GameState.boardHash equal to this incrementally;
+ * code that edits the board directly must refresh it.
+ * @param board The board rows.
+ * @return The hash, 0 for an empty board.
+ */
+uint64_t hashBoard(const uint16_t* board);
+
+/**
+ * Returns the hash of the board together with the falling tetromino: the
+ * board hash XOR a key for the tetromino's type, rotation and position.
+ * @param gs Pointer to the game state.
+ * @return The hash.
+ */
+uint64_t positionHash(const GameState* gs);
+
+/**
+ * Returns the row a tetromino comes to rest on when dropped straight down.
+ * The row is read from the column heights and the piece's bottom skirt;
+ * only a piece already below the surface of one of its columns (under an
+ * overhang) falls back to stepping down with fits().
+ * @param gs Pointer to the game state.
+ * @param type Type of tetromino (0–6 for I, L, O, T, S, Z, J).
+ * @param rotation Rotation index of the tetromino.
+ * @param x X-coordinate of the tetromino’s top-left corner.
+ * @param y Current y-coordinate; the tetromino must fit there.
+ * @return The y-coordinate of the landing position (>= y).
+ */
+int landingRow(const GameState* gs, int type, int rotation, int x, int y);
+
+/**
+ * Drops the current tetromino to its cached landing row and moves to
+ * kLocking.
+ * @param gs Pointer to the game state.
+ * @param state Pointer to the FSM state.
+ */
+void hardDropState(GameState* gs, FsmState* state);
+
+/**
+ * Deals a tetromino type from a piece generator. generateNextTetromino()
+ * and the batch engine share it, so both deal the same sequence.
+ * @param randomState Pointer to the PCG32 state.
+ * @param bagLeft Pointer to the types left in the 7-bag.
+ * @param randomizer How the tetromino is picked.
+ * @return Type of tetromino (0–6 for I, L, O, T, S, Z, J).
+ */
+int dealTetromino(uint64_t* randomState, uint8_t* bagLeft,
+                  PieceRandomizer randomizer);
 
 /**
  * Generates a new tetromino for the next slot.
- * @param gameInfo Pointer to the game information structure.
+ * @param gs Pointer to the game state.
  * @param type Pointer to store the tetromino type.
  * @param rotationIndex Pointer to store the rotation index.
  */
-void generateNextTetromino(GameInfo* gameInfo, int* type, int* rotationIndex);
+void generateNextTetromino(GameState* gs, int* type, int* rotationIndex);
 
 /**
  * Checks if the next tetromino exists.
- * @param gameInfo Pointer to the game information structure.
+ * @param gs Pointer to the game state.
  * @return True if the next tetromino exists, false otherwise.
  */
-bool hasNextTetromino(const GameInfo* gameInfo);
+bool hasNextTetromino(const GameState* gs);
 
 /**
- * Renders the game field and UI using ncurses.
- * @param gameInfo The game information structure.
+ * Refreshes a GameInfo view from the game state: the field and next
+ * matrices (when allocated) and the scalar fields.
+ * @param gs Pointer to the game state.
+ * @param view The view to refresh.
  */
-void renderField(GameInfo gameInfo);
+void syncFieldView(const GameState* gs, GameInfo* view);
 
 /**
  * Initializes the game state.
- * @param gameInfo Pointer to the game information structure.
+ * @param gs Pointer to the game state.
  */
-void startGame(GameInfo* gameInfo);
+void startGame(GameState* gs);
 
 /**
  * Handles the spawning of a new tetromino.
- * @param gameInfo Pointer to the game information structure.
- * @param currentTetromino Pointer to the current tetromino’s points.
+ * @param gs Pointer to the game state.
  * @param x Pointer to the tetromino’s x-coordinate.
  * @param y Pointer to the tetromino’s y-coordinate.
  * @param state Pointer to the game state.
  */
-void spawnTetrominoState(GameInfo* gameInfo, TetrominoPoints* currentTetromino,
-                         int* x, int* y, FsmState* state);
+void spawnTetrominoState(GameState* gs, int* x, int* y, FsmState* state);
 
 /**
  * Rotates the current tetromino clockwise.
- * @param gameInfo Pointer to the game information structure.
- * @param currentTetromino Pointer to the current tetromino’s points.
+ * @param gs Pointer to the game state.
  */
-void rotateTetromino(GameInfo* gameInfo, TetrominoPoints* currentTetromino);
+void rotateTetromino(GameState* gs);
 
 /**
  * Handles the falling of the current tetromino.
- * @param gameInfo Pointer to the game information structure.
- * @param currentTetromino Pointer to the current tetromino’s points.
- * @param state Pointer to the game state.
+ * @param gs Pointer to the game state.
+ * @param state Pointer to the FSM state.
  */
-void fallingTetrominoState(GameInfo* gameInfo,
-                           TetrominoPoints* currentTetromino, FsmState* state);
+void fallingTetrominoState(GameState* gs, FsmState* state);
+
+/**
+ * Moves the current tetromino one column left or right if it fits there,
+ * without a gravity step.
+ * @param gs Pointer to the game state.
+ * @param direction The movement direction (left or right).
+ * @return True if the tetromino moved.
+ */
+bool shiftTetromino(GameState* gs, UserAction direction);
 
 /**
  * Handles the moving of the current tetromino left or right.
- * @param gameInfo Pointer to the game information structure.
- * @param currentTetromino Pointer to the current tetromino’s points.
- * @param state Pointer to the game state.
+ * @param gs Pointer to the game state.
+ * @param state Pointer to the FSM state.
  * @param x Pointer to the tetromino’s x-coordinate.
  * @param direction The movement direction (left or right).
  */
-void movingTetrominoState(GameInfo* gameInfo, TetrominoPoints* currentTetromino,
-                          FsmState* state, int* x, UserAction direction);
+void movingTetrominoState(GameState* gs, FsmState* state, int* x,
+                          UserAction direction);
 
 /**
- * Handles the clearing of completed lines.
- * @param gameInfo Pointer to the game information structure.
- * @param state Pointer to the game state.
+ * Adds the points for a line clear and raises the level for every
+ * kPointsPerLevel points, up to kMaxLevel.
+ * @param lines Lines cleared at once (0–4).
+ * @param score Pointer to the score.
+ * @param level Pointer to the level.
+ * @param pointsTowardLevel Pointer to the points toward the next level.
  */
-void clearLinesState(GameInfo* gameInfo, FsmState* state);
+void scoreLines(int lines, int* score, int* level, int* pointsTowardLevel);
 
 /**
- * Sets the game to the game-over state.
- * @param gameInfo Pointer to the game information structure.
+ * Handles the clearing of completed lines.
+ * @param gs Pointer to the game state.
+ * @param state Pointer to the FSM state.
  */
-void gameOverState(GameInfo* gameInfo);
+void clearLinesState(GameState* gs, FsmState* state);
 
 /**
- * Cleans up game resources.
+ * Sets the game to the game-over state.
+ * @param gs Pointer to the game state.
  */
-void cleanupGame();
+void gameOverState(GameState* gs);
 
 /**
- * Clears the current tetromino from the game field.
- * @param gameInfo Pointer to the game information structure.
- * @param currentTetromino Pointer to the current tetromino’s points.
+ * Frees the GameInfo view of a game instance. The view is allocated again
+ * by the next update.
+ * @param game The game instance.
  */
-void clearTetromino(GameInfo* gameInfo, TetrominoPoints* currentTetromino);
+void cleanupGame(TetrisGame* game);
 
 /**
  * Retrieves the rotation offsets for a given tetromino type.
@@ -247,88 +578,27 @@ void clearTetromino(GameInfo* gameInfo, TetrominoPoints* currentTetromino);
 void getRotationOffsets(int tetrominoType, int offsets[][2], int* numOffsets);
 
 /**
- * Checks if a rotation is valid at the specified position.
- * @param gameInfo Pointer to the game information structure.
- * @param shape The tetromino shape matrix.
- * @param newX X-coordinate of the tetromino’s top-left corner.
- * @param newY Y-coordinate of the tetromino’s top-left corner.
- * @return True if the rotation is valid, false otherwise.
+ * Checks if a tetromino fits the field at the specified position. The
+ * test is a bounding-box check followed by AND-ing the packed piece rows
+ * against the locked board rows.
+ * @param gs Pointer to the game state.
+ * @param type Type of tetromino (0–6 for I, L, O, T, S, Z, J).
+ * @param rotation Rotation index of the tetromino.
+ * @param x X-coordinate of the tetromino’s top-left corner.
+ * @param y Y-coordinate of the tetromino’s top-left corner.
+ * @return True if every cell is inside the field and unoccupied.
  */
-bool isValidRotation(GameInfo* gameInfo, const int shape[][kFigureSize],
-                     int newX, int newY);
+bool fits(const GameState* gs, int type, int rotation, int x, int y);
 
 /**
  * Applies a rotation to the current tetromino.
- * @param gameInfo Pointer to the game information structure.
- * @param currentTetromino Pointer to the current tetromino’s points.
+ * @param gs Pointer to the game state.
  * @param tetrominoType Type of tetromino (0–6 for I, L, O, T, S, Z, J).
  * @param nextRotation The rotation index to apply.
  * @param newX X-coordinate of the tetromino’s top-left corner.
  * @param newY Y-coordinate of the tetromino’s top-left corner.
- * @param gs Pointer to the game state.
- */
-void applyRotation(GameInfo* gameInfo, TetrominoPoints* currentTetromino,
-                   int tetrominoType, int nextRotation, int newX, int newY,
-                   GameState* gs);
-
-/**
- * Retrieves the lowest Y-coordinates for each column of the tetromino.
- * @param currentTetromino Pointer to the current tetromino’s points.
- * @param lowestY Array to store the lowest Y-coordinates for each column.
- */
-void getLowestPoints(TetrominoPoints* currentTetromino, int lowestY[]);
-
-/**
- * Checks if the tetromino can move down.
- * @param gameInfo Pointer to the game information structure.
- * @param lowestY Array of the lowest Y-coordinates for each column.
- * @return True if the tetromino can move down, false otherwise.
- */
-bool canMoveDown(GameInfo* gameInfo, int lowestY[]);
-
-/**
- * Moves the tetromino down by one row.
- * @param gameInfo Pointer to the game information structure.
- * @param currentTetromino Pointer to the current tetromino’s points.
- */
-void moveTetrominoDown(GameInfo* gameInfo, TetrominoPoints* currentTetromino);
-
-/**
- * Updates the tetromino’s Y-coordinate in the game state.
- * @param currentTetromino Pointer to the current tetromino’s points.
- * @param gs Pointer to the game state.
- */
-void updateTetrominoY(TetrominoPoints* currentTetromino, GameState* gs);
-
-/**
- * Retrieves the extreme X-coordinates and point counts per row for sideways
- * movement.
- * @param currentTetromino Pointer to the current tetromino’s points.
- * @param direction The movement direction (left or right).
- * @param extremeX Array to store the extreme X-coordinates for each row.
- * @param pointsPerY Array to store the number of points in each row.
- */
-void getExtremePoints(TetrominoPoints* currentTetromino, UserAction direction,
-                      int extremeX[], int pointsPerY[]);
-
-/**
- * Checks if the tetromino can move sideways.
- * @param gameInfo Pointer to the game information structure.
- * @param extremeX Array of extreme X-coordinates for each row.
- * @param pointsPerY Array of point counts per row.
- * @param deltaX The movement offset (-1 for left, 1 for right).
- * @return True if the tetromino can move sideways, false otherwise.
- */
-bool canMoveSideways(GameInfo* gameInfo, int extremeX[], int pointsPerY[],
-                     int deltaX);
-
-/**
- * Shifts the tetromino sideways by the specified offset.
- * @param gameInfo Pointer to the game information structure.
- * @param currentTetromino Pointer to the current tetromino’s points.
- * @param deltaX The movement offset (-1 for left, 1 for right).
  */
-void shiftTetromino(GameInfo* gameInfo, TetrominoPoints* currentTetromino,
-                    int deltaX);
+void applyRotation(GameState* gs, int tetrominoType, int nextRotation,
+                   int newX, int newY);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,53 @@
+#include "transposition.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Mixed into the check word so that zeroed slots match no likely key.
+static const uint64_t kTtTag = 0xD6E8FEB86659FD93ULL;
+
+int ttCreate(TranspositionTable* table, int bits) {
+  if (bits < 1 || bits > 30) {
+    fprintf(stderr, "Invalid transposition table size 2^%d\n", bits);
+    return 1;
+  }
+  size_t slots = (size_t)1 << bits;
+  table->entries = calloc(slots, sizeof(TtEntry));
+  if (!table->entries) {
+    fprintf(stderr, "Failed to allocate transposition table\n");
+    return 1;
+  }
+  table->mask = slots - 1;
+  return 0;
+}
+
+void ttDestroy(TranspositionTable* table) {
+  free(table->entries);
+  table->entries = NULL;
+  table->mask = 0;
+}
+
+void ttClear(TranspositionTable* table) {
+  for (uint64_t i = 0; i <= table->mask; ++i) {
+    atomic_init(&table->entries[i].check, 0);
+    atomic_init(&table->entries[i].value, 0);
+  }
+}
+
+bool ttProbe(const TranspositionTable* table, uint64_t key, uint64_t* value) {
+  TtEntry* entry = &table->entries[key & table->mask];
+  uint64_t stored = atomic_load_explicit(&entry->value, memory_order_relaxed);
+  uint64_t check = atomic_load_explicit(&entry->check, memory_order_relaxed);
+  if ((check ^ stored ^ kTtTag) != key) {
+    return false;
+  }
+  *value = stored;
+  return true;
+}
+
+void ttStore(TranspositionTable* table, uint64_t key, uint64_t value) {
+  TtEntry* entry = &table->entries[key & table->mask];
+  atomic_store_explicit(&entry->value, value, memory_order_relaxed);
+  atomic_store_explicit(&entry->check, key ^ value ^ kTtTag,
+                        memory_order_relaxed);
+}
@@ -0,0 +1,62 @@
+#ifndef TETRIS_TRANSPOSITION_H_
+#define TETRIS_TRANSPOSITION_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Slot of the table. The check word holds key ^ value ^ kTtTag, so a slot
+// torn by two writers racing on it fails the check instead of returning
+// the value of another key.
+typedef struct {
+  atomic_uint_least64_t check;  // Key XOR value XOR kTtTag.
+  atomic_uint_least64_t value;  // Stored value.
+} TtEntry;
+
+// Fixed-size hash table from 64-bit keys (Zobrist hashes) to 64-bit values
+// that any number of threads may probe and fill at once without locks.
+// A store overwrites whatever the slot held, so entries can be lost but
+// never mixed up.
+typedef struct {
+  TtEntry* entries;  // 1 << bits slots.
+  uint64_t mask;     // Slot count minus one.
+} TranspositionTable;
+
+/**
+ * Allocates an empty table.
+ * @param table The table to set up.
+ * @param bits Log2 of the slot count (1–30).
+ * @return 0 on success, non-zero on invalid size or allocation failure.
+ */
+int ttCreate(TranspositionTable* table, int bits);
+
+/**
+ * Frees the slots of a table.
+ * @param table The table.
+ */
+void ttDestroy(TranspositionTable* table);
+
+/**
+ * Empties a table. Must not run concurrently with probes or stores.
+ * @param table The table.
+ */
+void ttClear(TranspositionTable* table);
+
+/**
+ * Looks a key up.
+ * @param table The table.
+ * @param key The key.
+ * @param value Pointer to receive the value.
+ * @return True if the key was found.
+ */
+bool ttProbe(const TranspositionTable* table, uint64_t key, uint64_t* value);
+
+/**
+ * Stores a value for a key, replacing the slot's previous entry.
+ * @param table The table.
+ * @param key The key.
+ * @param value The value.
+ */
+void ttStore(TranspositionTable* table, uint64_t key, uint64_t value);
+
+#endif
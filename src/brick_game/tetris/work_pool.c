@@ -0,0 +1,261 @@
+#include "work_pool.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Job indices [begin, end) owned by one worker, packed as begin | end << 32
+// so that the owner and thieves update them with one compare-and-swap.
+// Each slice has its own cache line.
+typedef struct {
+  _Alignas(64) atomic_uint_least64_t range;
+} WorkSlice;
+
+// Job and context of one parallelFor() call.
+typedef struct {
+  ParallelTask task;  // Job function.
+  void* context;      // Job context.
+} ParallelJob;
+
+// Start argument of a worker thread.
+typedef struct {
+  WorkPool* pool;  // Owning pool.
+  int worker;      // Worker number.
+} WorkSeat;
+
+struct WorkPool {
+  int threads;            // Workers, the calling thread included.
+  WorkSlice* slices;      // One slice per worker.
+  WorkSeat* seats;        // Start arguments of the threads.
+  pthread_t* handles;     // Started threads (threads - 1).
+  pthread_mutex_t lock;   // Guards the fields below.
+  pthread_cond_t wake;    // Signals a new batch or shutdown.
+  pthread_cond_t idle;    // Signals that the threads finished a batch.
+  unsigned generation;    // Number of batches started.
+  int running;            // Threads still busy with the batch.
+  bool shutdown;          // Threads must exit.
+  WorkTask task;          // Job function of the batch.
+  void* context;          // Job context of the batch.
+};
+
+static uint64_t packRange(uint32_t begin, uint32_t end) {
+  return begin | (uint64_t)end << 32;
+}
+
+/**
+ * Takes the front job of a slice.
+ * @param slice The slice.
+ * @param index Pointer to receive the job index.
+ * @return False if the slice is empty.
+ */
+static bool popFront(WorkSlice* slice, int* index) {
+  uint64_t range = atomic_load(&slice->range);
+  for (;;) {
+    uint32_t begin = (uint32_t)range;
+    uint32_t end = (uint32_t)(range >> 32);
+    if (begin >= end) {
+      return false;
+    }
+    if (atomic_compare_exchange_weak(&slice->range, &range,
+                                     packRange(begin + 1, end))) {
+      *index = (int)begin;
+      return true;
+    }
+  }
+}
+
+/**
+ * Moves the back half of the first non-empty slice of another worker into
+ * the thief's empty slice. Only the owner ever fills a slice, so no one
+ * else writes the thief's slice meanwhile.
+ * @param pool The pool.
+ * @param thief Worker number of the thief.
+ * @return False if every other slice is empty.
+ */
+static bool steal(WorkPool* pool, int thief) {
+  for (int k = 1; k < pool->threads; ++k) {
+    WorkSlice* victim = &pool->slices[(thief + k) % pool->threads];
+    uint64_t range = atomic_load(&victim->range);
+    for (;;) {
+      uint32_t begin = (uint32_t)range;
+      uint32_t end = (uint32_t)(range >> 32);
+      if (begin >= end) {
+        break;
+      }
+      uint32_t middle = end - (end - begin + 1) / 2;
+      if (atomic_compare_exchange_weak(&victim->range, &range,
+                                       packRange(begin, middle))) {
+        atomic_store(&pool->slices[thief].range, packRange(middle, end));
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+/**
+ * Runs jobs of the current batch until no slice has any left.
+ * @param pool The pool.
+ * @param worker Worker number.
+ */
+static void runBatch(WorkPool* pool, int worker) {
+  WorkSlice* own = &pool->slices[worker];
+  int index;
+  do {
+    while (popFront(own, &index)) {
+      pool->task(index, worker, pool->context);
+    }
+  } while (steal(pool, worker));
+}
+
+static void* poolWorker(void* arg) {
+  WorkSeat* seat = arg;
+  WorkPool* pool = seat->pool;
+  unsigned seen = 0;
+  pthread_mutex_lock(&pool->lock);
+  for (;;) {
+    while (!pool->shutdown && pool->generation == seen) {
+      pthread_cond_wait(&pool->wake, &pool->lock);
+    }
+    if (pool->shutdown) {
+      break;
+    }
+    seen = pool->generation;
+    pthread_mutex_unlock(&pool->lock);
+    runBatch(pool, seat->worker);
+    pthread_mutex_lock(&pool->lock);
+    if (--pool->running == 0) {
+      pthread_cond_signal(&pool->idle);
+    }
+  }
+  pthread_mutex_unlock(&pool->lock);
+  return NULL;
+}
+
+WorkPool* workPoolCreate(int threads) {
+  if (threads < 1) {
+    threads = 1;
+  }
+  WorkPool* pool = calloc(1, sizeof(WorkPool));
+  if (!pool) {
+    fprintf(stderr, "Failed to allocate work pool\n");
+    return NULL;
+  }
+  pool->slices =
+      aligned_alloc(_Alignof(WorkSlice), threads * sizeof(WorkSlice));
+  pool->seats = malloc(threads * sizeof(WorkSeat));
+  pool->handles = malloc(threads * sizeof(pthread_t));
+  if (!pool->slices || !pool->seats || !pool->handles) {
+    fprintf(stderr, "Failed to allocate work pool\n");
+    free(pool->slices);
+    free(pool->seats);
+    free(pool->handles);
+    free(pool);
+    return NULL;
+  }
+  for (int i = 0; i < threads; ++i) {
+    atomic_init(&pool->slices[i].range, 0);
+  }
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->wake, NULL);
+  pthread_cond_init(&pool->idle, NULL);
+  pool->threads = 1;
+  for (int i = 1; i < threads; ++i) {
+    pool->seats[i] = (WorkSeat){pool, i};
+    if (pthread_create(&pool->handles[i - 1], NULL, poolWorker,
+                       &pool->seats[i]) != 0) {
+      // Пул работает с теми потоками, что удалось запустить.
+      fprintf(stderr, "Failed to start worker thread %d\n", i);
+      break;
+    }
+    pool->threads++;
+  }
+  return pool;
+}
+
+void workPoolDestroy(WorkPool* pool) {
+  if (!pool) {
+    return;
+  }
+  pthread_mutex_lock(&pool->lock);
+  pool->shutdown = true;
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->lock);
+  for (int i = 0; i < pool->threads - 1; ++i) {
+    pthread_join(pool->handles[i], NULL);
+  }
+  pthread_cond_destroy(&pool->idle);
+  pthread_cond_destroy(&pool->wake);
+  pthread_mutex_destroy(&pool->lock);
+  free(pool->slices);
+  free(pool->seats);
+  free(pool->handles);
+  free(pool);
+}
+
+int workPoolThreads(const WorkPool* pool) { return pool->threads; }
+
+void workPoolRun(WorkPool* pool, int count, WorkTask task, void* context) {
+  if (count <= 0) {
+    return;
+  }
+  int threads = pool->threads;
+  for (int i = 0; i < threads; ++i) {
+    uint32_t begin = (uint32_t)((long long)count * i / threads);
+    uint32_t end = (uint32_t)((long long)count * (i + 1) / threads);
+    atomic_store(&pool->slices[i].range, packRange(begin, end));
+  }
+  pool->task = task;
+  pool->context = context;
+  if (threads > 1) {
+    pthread_mutex_lock(&pool->lock);
+    pool->running = threads - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+  }
+  // Вызывающий поток работает как worker 0.
+  runBatch(pool, 0);
+  if (threads > 1) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->running > 0) {
+      pthread_cond_wait(&pool->idle, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+  }
+}
+
+int defaultThreadCount(void) {
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  return cores > 0 ? (int)cores : 1;
+}
+
+/**
+ * Runs one job of a parallelFor() call.
+ * @param index Job index.
+ * @param worker Worker number (unused).
+ * @param context The ParallelJob.
+ */
+static void runParallelJob(int index, int worker, void* context) {
+  (void)worker;
+  const ParallelJob* job = context;
+  job->task(index, job->context);
+}
+
+int parallelFor(int count, int threads, ParallelTask task, void* context) {
+  if (count <= 0) {
+    return 0;
+  }
+  WorkPool* pool = workPoolCreate(threads < count ? threads : count);
+  if (!pool) {
+    return 1;
+  }
+  ParallelJob job = {task, context};
+  workPoolRun(pool, count, runParallelJob, &job);
+  workPoolDestroy(pool);
+  return 0;
+}
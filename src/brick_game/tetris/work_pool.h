@@ -0,0 +1,65 @@
+#ifndef TETRIS_WORK_POOL_H_
+#define TETRIS_WORK_POOL_H_
+
+// Job executed by the pool for each index of a batch. The worker number is
+// in [0, workPoolThreads()) and lets jobs use per-worker scratch memory.
+typedef void (*WorkTask)(int index, int worker, void* context);
+
+// Job of parallelFor() for each index in [0, count).
+typedef void (*ParallelTask)(int index, void* context);
+
+// Persistent worker threads that run batches of indexed jobs.
+typedef struct WorkPool WorkPool;
+
+/**
+ * Starts a pool. The calling thread counts as worker 0, so a pool of one
+ * thread starts nothing and runs every batch inline.
+ * @param threads Number of workers (at least 1).
+ * @return The pool, NULL if it could not be allocated.
+ */
+WorkPool* workPoolCreate(int threads);
+
+/**
+ * Stops the worker threads and frees the pool.
+ * @param pool The pool (may be NULL).
+ */
+void workPoolDestroy(WorkPool* pool);
+
+/**
+ * Returns the number of workers of a pool, the calling thread included.
+ * @param pool The pool.
+ * @return The number of workers.
+ */
+int workPoolThreads(const WorkPool* pool);
+
+/**
+ * Runs task(i, worker, context) for every i in [0, count) and returns when
+ * all jobs have finished. Every worker starts with an equal slice of the
+ * indices and takes jobs from its front; a worker whose slice runs out
+ * steals the back half of another worker's slice, so uneven jobs balance
+ * without a shared counter.
+ * @param pool The pool.
+ * @param count Number of jobs.
+ * @param task The job function.
+ * @param context Opaque pointer passed to every job.
+ */
+void workPoolRun(WorkPool* pool, int count, WorkTask task, void* context);
+
+/**
+ * Returns the number of online CPU cores (at least 1).
+ * @return The number of worker threads to use by default.
+ */
+int defaultThreadCount(void);
+
+/**
+ * Runs task(i, context) for every i in [0, count) as one batch of a
+ * temporary pool. Returns when every job has finished.
+ * @param count Number of jobs.
+ * @param threads Number of worker threads (clamped to [1, count]).
+ * @param task The job function.
+ * @param context Opaque pointer passed to every job.
+ * @return 0 on success, non-zero if the pool could not be allocated.
+ */
+int parallelFor(int count, int threads, ParallelTask task, void* context);
+
+#endif
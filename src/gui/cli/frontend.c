@@ -0,0 +1,137 @@
+#include "frontend.h"
+
+// Screen layout.
+enum {
+  kSidebarX = kCol + 3,  // Left edge of the sidebar.
+  kPreviewY = 2,         // Top row of the next-piece preview.
+  kOverlayY = kRow / 2,  // Row of the PAUSED / GAME OVER banner.
+  kStatWidth = 10,       // Width reserved for sidebar numbers.
+  kPreviewMask = 0xF     // Row mask of the 4-column preview.
+};
+
+// Frame currently shown on the terminal.
+typedef struct {
+  bool valid;                 // False until the next full repaint.
+  uint16_t rows[kRow];        // Field rows as drawn.
+  uint16_t ghost[kRow];       // Ghost piece rows as drawn.
+  uint8_t next[kFigureSize];  // Next-piece preview rows as drawn.
+  int level;                  // Level as drawn.
+  int score;                  // Score as drawn.
+  int highScore;              // High score as drawn.
+  int pause;                  // Pause flag as drawn.
+} RenderCache;
+
+static RenderCache renderCache;
+
+void invalidateRender() { renderCache.valid = false; }
+
+/**
+ * Returns the character of one cell.
+ * @param row Cell mask of the row.
+ * @param ghost Ghost piece mask of the row.
+ * @param j Column of the cell.
+ * @return The character to draw.
+ */
+static chtype cellChar(unsigned row, unsigned ghost, int j) {
+  return (row >> j) & 1 ? 'o' : ((ghost >> j) & 1 ? '.' : ' ');
+}
+
+/**
+ * Repaints the changed part of one row of cells.
+ * @param y Screen row.
+ * @param x Screen column of bit 0.
+ * @param row Cell mask to draw.
+ * @param ghost Ghost piece mask to draw where the row is empty.
+ * @param dirty Mask of cells that differ from the screen.
+ */
+static void drawRowSpan(int y, int x, unsigned row, unsigned ghost,
+                        unsigned dirty) {
+  if (!dirty) {
+    return;
+  }
+  int first = __builtin_ctz(dirty);
+  int last = 31 - __builtin_clz(dirty);
+  if (first == last) {
+    mvaddch(y, x + first, cellChar(row, ghost, first));
+  } else {
+    chtype cells[16];
+    for (int j = first; j <= last; ++j) {
+      cells[j - first] = cellChar(row, ghost, j);
+    }
+    mvaddchnstr(y, x + first, cells, last - first + 1);
+  }
+}
+
+/**
+ * Draws the parts of the screen that never change.
+ */
+static void drawFrame() {
+  for (int i = 0; i < kRow; ++i) {
+    mvaddch(i, kCol, '|');
+  }
+  chtype border[kCol + 1];
+  for (int i = 0; i < kCol + 1; ++i) {
+    border[i] = '-';
+  }
+  mvaddchnstr(kRow, 0, border, kCol + 1);
+  mvprintw(0, kSidebarX, "Next");
+}
+
+void renderField(const TetrisFrame* frame) {
+  RenderCache* cache = &renderCache;
+  bool full = !cache->valid;
+  if (full) {
+    drawFrame();
+  }
+
+  // Баннер паузы перекрывает строку поля, поэтому при смене флага паузы
+  // строка перерисовывается целиком, а баннер выводится поверх неё.
+  bool pauseChanged = full || frame->pause != cache->pause;
+  bool overlayDrawn = false;
+  for (int i = 0; i < kRow; ++i) {
+    uint16_t row = frame->field[i];
+    uint16_t ghost = frame->ghost[i];
+    unsigned dirty = full ? kFullRow
+                          : (unsigned)((row ^ cache->rows[i]) |
+                                       (ghost ^ cache->ghost[i]));
+    if (i == kOverlayY && pauseChanged) {
+      dirty = kFullRow;
+    }
+    if (i == kOverlayY) {
+      overlayDrawn = dirty != 0;
+    }
+    drawRowSpan(i, 0, row, ghost, dirty);
+    cache->rows[i] = row;
+    cache->ghost[i] = ghost;
+  }
+
+  for (int i = 0; i < kFigureSize; ++i) {
+    uint8_t row = frame->next[i];
+    unsigned dirty = full ? kPreviewMask : (unsigned)(row ^ cache->next[i]);
+    drawRowSpan(i + kPreviewY, kSidebarX, row, 0, dirty);
+    cache->next[i] = row;
+  }
+
+  if (full || frame->level != cache->level) {
+    mvprintw(6, kSidebarX, "Level: %-*d", kStatWidth, frame->level);
+  }
+  if (full || frame->score != cache->score) {
+    mvprintw(7, kSidebarX, "Score: %-*d", kStatWidth, frame->score);
+  }
+  if (full || frame->highScore != cache->highScore) {
+    mvprintw(8, kSidebarX, "High Score: %-*d", kStatWidth,
+             frame->highScore);
+  }
+  cache->level = frame->level;
+  cache->score = frame->score;
+  cache->highScore = frame->highScore;
+
+  if (overlayDrawn && frame->pause == 1) {
+    mvprintw(kOverlayY, kCol / 2 - 3, "PAUSED");
+  } else if (overlayDrawn && frame->pause == -1) {
+    mvprintw(kOverlayY, kCol / 2 - 5, "GAME OVER");
+  }
+  cache->pause = frame->pause;
+  cache->valid = true;
+  refresh();
+}
@@ -0,0 +1,29 @@
+#ifndef TETRIS_FRONTEND_H_
+#define TETRIS_FRONTEND_H_
+
+#include <ncurses.h>
+
+#include "shm_ring.h"
+#include "tetris.h"
+
+/**
+ * Initializes and runs the Tetris game.
+ * @param autoplay True to let the bot play.
+ * @param ring Shared memory ring for a trainer, or NULL.
+ * @return 0 on successful termination, non-zero on error.
+ */
+int runTetris(bool autoplay, TetrisShmRing* ring);
+
+/**
+ * Renders the game field and UI using ncurses. Only the cells and values
+ * that changed since the previous call are redrawn.
+ * @param frame The frame to show.
+ */
+void renderField(const TetrisFrame* frame);
+
+/**
+ * Forces the next renderField call to repaint the whole screen.
+ */
+void invalidateRender();
+
+#endif
@@ -1,11 +1,146 @@
-#include "tetris.h"
+#include <poll.h>
+#include <unistd.h>
+
+#include "autoplay.h"
+#include "frontend.h"
+#include "replay.h"
+#include "shm_ring.h"
+
+// Keys forwarded to the engine per batch.
+enum { kMaxKeysPerFrame = 64 };
+
+// Longest wait for trainer actions with --shm, in ms.
+enum { kShmPollMs = 1 };
+
+/**
+ * Advances a monotonic time point by the given number of milliseconds.
+ * @param time The time point to advance.
+ * @param ms Milliseconds to add.
+ */
+static void addMilliseconds(struct timespec* time, int ms) {
+  time->tv_sec += ms / 1000;
+  time->tv_nsec += (long)(ms % 1000) * 1000000L;
+  if (time->tv_nsec >= 1000000000L) {
+    time->tv_sec++;
+    time->tv_nsec -= 1000000000L;
+  }
+}
+
+/**
+ * Returns the milliseconds left until a monotonic deadline, rounded up.
+ * @param deadline The absolute deadline.
+ * @return Milliseconds until the deadline, 0 if it has passed.
+ */
+static int millisecondsUntil(const struct timespec* deadline) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  long long ns = (long long)(deadline->tv_sec - now.tv_sec) * 1000000000LL +
+                 (deadline->tv_nsec - now.tv_nsec);
+  return ns > 0 ? (int)((ns + 999999) / 1000000) : 0;
+}
+
+/**
+ * Maps a key to a user action.
+ * @param ch The key read by getch().
+ * @param action Pointer to store the action.
+ * @return True if the key is bound to an action.
+ */
+static bool keyToAction(int ch, UserAction* action) {
+  bool bound = true;
+  switch (ch) {
+    case 'q':
+      *action = kActionTerminate;
+      break;
+    case 'p':
+      *action = kActionPause;
+      break;
+    case KEY_LEFT:
+      *action = kActionLeft;
+      break;
+    case KEY_RIGHT:
+      *action = kActionRight;
+      break;
+    case KEY_DOWN:
+      *action = kActionDown;
+      break;
+    case ' ':
+      *action = kActionRotate;
+      break;
+    default:
+      bound = false;
+      break;
+  }
+  return bound;
+}
+
+/**
+ * Drains every pending key and forwards them to the engine in order.
+ * @return Number of actions forwarded.
+ */
+static int drainKeys() {
+  UserAction actions[kMaxKeysPerFrame];
+  int n = 0;
+  int total = 0;
+  int ch;
+  while ((ch = getch()) != ERR) {
+    if (keyToAction(ch, &actions[n]) && ++n == kMaxKeysPerFrame) {
+      userInputBatch(actions, NULL, n);
+      total += n;
+      n = 0;
+    }
+  }
+  userInputBatch(actions, NULL, n);
+  return total + n;
+}
+
+/**
+ * Drains every action queued by the trainer and forwards them in order.
+ * @param ring The shared memory ring.
+ * @return Number of actions forwarded.
+ */
+static int drainRing(TetrisShmRing* ring) {
+  UserAction actions[kMaxKeysPerFrame];
+  int n = 0;
+  int total = 0;
+  while (tetris_shmPopAction(ring, &actions[n])) {
+    if (++n == kMaxKeysPerFrame) {
+      userInputBatch(actions, NULL, n);
+      total += n;
+      n = 0;
+    }
+  }
+  userInputBatch(actions, NULL, n);
+  return total + n;
+}
 
 /**
- * Initializes and runs the Tetris game with ncurses.
+ * Applies the sideways move left pending by the input as a plain shift
+ * and lets the bot, if any, play until it has to wait for a tick.
+ * @param bot The bot state, or NULL without autoplay.
+ * @return Number of actions applied.
+ */
+static int settleInput(Autoplay* bot) {
+  TetrisGame* game = getDefaultGame();
+  int applied = tetris_applyPendingShift(game);
+  FsmState before = game->state.state;
+  while (bot && autoplayStep(bot, game)) {
+    ++applied;
+  }
+  // Последнее действие бота (сброс) autoplayStep() не засчитывает.
+  applied += game->state.state != before;
+  return applied;
+}
+
+/**
+ * Initializes and runs the Tetris game with ncurses. Keys are handled as
+ * soon as they arrive; gravity ticks follow their own absolute schedule
+ * derived from the current game speed.
+ * @param autoplay True to let the bot play; the keys still pause and quit.
+ * @param ring Ring to publish observations to and take actions from, or
+ *             NULL.
  * @return 0 on successful termination, non-zero on error.
  */
-int runTetris() {
-  srand(time(NULL));
+int runTetris(bool autoplay, TetrisShmRing* ring) {
   WINDOW* scr = initscr();
   if (!scr) {
     fprintf(stderr, "Failed to initialize ncurses\n");
@@ -16,43 +151,95 @@ int runTetris() {
   cbreak();
   nodelay(stdscr, true);
   curs_set(0);
+  invalidateRender();
   userInput(kActionStart, false);
-  while (true) {
-    int ch = getch();
-    if (ch != ERR) {
-      switch (ch) {
-        case 'q':
-          userInput(kActionTerminate, false);
-          break;
-        case 'p':
-          userInput(kActionPause, false);
-          break;
-        case KEY_LEFT:
-          userInput(kActionLeft, false);
-          break;
-        case KEY_RIGHT:
-          userInput(kActionRight, false);
-          break;
-        case KEY_DOWN:
-          userInput(kActionDown, false);
-          break;
-        case ' ':
-          userInput(kActionRotate, false);
-          break;
+
+  updateCurrentState();
+  Autoplay bot = {.weights = &kDefaultEvalWeights};
+  const GameStats* stats = &getGameState()->stats;
+  struct timespec nextTick;
+  clock_gettime(CLOCK_MONOTONIC, &nextTick);
+  addMilliseconds(&nextTick, stats->speed);
+  if (ring) {
+    tetris_shmPublish(ring, getGameState());
+  }
+  while (stats->pause != -1) {
+    renderField(tetris_currentFrame(getDefaultGame()));
+
+    struct pollfd input = {.fd = STDIN_FILENO, .events = POLLIN};
+    int wait = millisecondsUntil(&nextTick);
+    poll(&input, 1, ring && wait > kShmPollMs ? kShmPollMs : wait);
+
+    // Боковой сдвиг, оставшийся в конце пакета, применяется сразу без шага
+    // падения: гравитация идёт только по своему расписанию.
+    int inputs = drainKeys();
+    if (ring) {
+      inputs += drainRing(ring);
+    }
+    inputs += settleInput(autoplay ? &bot : NULL);
+    bool ticked = millisecondsUntil(&nextTick) == 0;
+    if (ticked) {
+      updateCurrentState();
+      addMilliseconds(&nextTick, stats->speed);
+      if (millisecondsUntil(&nextTick) == 0) {
+        clock_gettime(CLOCK_MONOTONIC, &nextTick);
       }
+    } else if (inputs > 0) {
+      // Тик публикует кадр сам, без него кадр нужен только после ввода.
+      tetris_publishFrame(getDefaultGame());
+    }
+    // Кадр уходит тренеру только после изменения состояния игры.
+    if (ring && (inputs > 0 || ticked)) {
+      tetris_shmPublish(ring, getGameState());
     }
-    GameInfo state = updateCurrentState();
-    if (state.pause == -1) break;
-    clear();
-    renderField(state);
-    napms(state.speed);
   }
   endwin();
   return 0;
 }
 
 /**
- * Entry point for the Tetris game.
+ * Entry point for the Tetris game. With --record FILE the game is saved
+ * as a replay log when it ends; with --autoplay the bot plays it; with
+ * --shm NAME every frame is published to a shared memory ring and the
+ * actions queued there are played.
  * @return 0 on successful termination, non-zero on error.
  */
-int main() { return runTetris(); }
\ No newline at end of file
+int main(int argc, char* argv[]) {
+  const char* recordPath = NULL;
+  const char* shmName = NULL;
+  bool autoplay = false;
+  bool valid = true;
+  for (int i = 1; i < argc && valid; ++i) {
+    if (strcmp(argv[i], "--autoplay") == 0) {
+      autoplay = true;
+    } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+      recordPath = argv[++i];
+    } else if (strcmp(argv[i], "--shm") == 0 && i + 1 < argc) {
+      shmName = argv[++i];
+    } else {
+      valid = false;
+    }
+  }
+  if (!valid) {
+    fprintf(stderr, "Usage: %s [--autoplay] [--record FILE] [--shm NAME]\n",
+            argv[0]);
+    return 1;
+  }
+  tetris_seed(getDefaultGame(), (uint64_t)time(NULL));
+  if (recordPath && tetris_startRecording(getDefaultGame()) != 0) {
+    return 1;
+  }
+  TetrisShmRing* ring = NULL;
+  if (shmName) {
+    ring = tetris_shmCreate(shmName, kShmFrameSlots, kShmActionSlots);
+    if (!ring) {
+      return 1;
+    }
+  }
+  int status = runTetris(autoplay, ring);
+  tetris_shmClose(ring);
+  if (recordPath && tetris_saveRecording(getDefaultGame(), recordPath) != 0) {
+    status = 1;
+  }
+  return status;
+}
@@ -3,10 +3,20 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-
+#include <unistd.h>
+
+#include "../brick_game/tetris/autoplay.h"
+#include "../brick_game/tetris/batch.h"
+#include "../brick_game/tetris/board_features.h"
+#include "../brick_game/tetris/placement.h"
+#include "../brick_game/tetris/planner.h"
+#include "../brick_game/tetris/replay.h"
+#include "../brick_game/tetris/shm_ring.h"
 #include "../brick_game/tetris/tetris.h"
+#include "../brick_game/tetris/transposition.h"
+#include "../gui/cli/frontend.h"
 
-// Structure to track mvprintw calls
+// Structure to track drawing calls
 #define MAX_CALLS 1000
 typedef struct {
   int y;
@@ -18,6 +28,8 @@ typedef struct {
   MvprintwCall calls[MAX_CALLS];
   int call_count;
   int refresh_count;
+  int cursor_y;
+  int cursor_x;
 } NcursesMock;
 
 NcursesMock mock = {0};
@@ -35,6 +47,32 @@ int mvprintw(int y, int x, const char* fmt, ...) {
   return 0;
 }
 
+// Mock for wmove, used by mvaddch and mvaddchnstr
+int wmove(WINDOW* win, int y, int x) {
+  (void)win;
+  mock.cursor_y = y;
+  mock.cursor_x = x;
+  return 0;
+}
+
+// Mock for waddchnstr, recorded at the cursor like mvprintw
+int waddchnstr(WINDOW* win, const chtype* str, int n) {
+  (void)win;
+  if (mock.call_count >= MAX_CALLS) return -1;
+  MvprintwCall* call = &mock.calls[mock.call_count++];
+  call->y = mock.cursor_y;
+  call->x = mock.cursor_x;
+  int len = 0;
+  for (; len < n && len < (int)sizeof(call->str) - 1; ++len) {
+    call->str[len] = (char)str[len];
+  }
+  call->str[len] = '\0';
+  return 0;
+}
+
+// Mock for waddch
+int waddch(WINDOW* win, const chtype ch) { return waddchnstr(win, &ch, 1); }
+
 // Mock for refresh
 void mock_refresh(void) { mock.refresh_count++; }
 
@@ -50,14 +88,16 @@ void resetMock(void) {
  */
 GameState* initGameState() {
   GameState* gs = getGameState();
-  gs->gameInfo.field = allocMatrix(kRow, kCol);
-  gs->gameInfo.next = allocMatrix(kFigureSize, kFigureSize);
-  gs->gameInfo.score = 0;
-  gs->gameInfo.high_score = 0;
-  gs->gameInfo.level = 1;
-  gs->gameInfo.speed = kSpeed;
-  gs->gameInfo.pause = 0;
+  gs->stats.score = 0;
+  gs->stats.high_score = 0;
+  gs->stats.level = 1;
+  gs->stats.speed = kSpeed;
+  gs->stats.pause = 0;
   gs->pointsTowardLevel = 0;
+  memset(gs->board, 0, sizeof(gs->board));
+  memset(gs->columnHeights, 0, sizeof(gs->columnHeights));
+  gs->pieceActive = false;
+  gs->nextTetrominoType = kNoTetromino;
   gs->state = kStart;
   return gs;
 }
@@ -103,21 +143,17 @@ END_TEST
  */
 START_TEST(testSpawnTetromino) {
   GameState* gs = initGameState();
-  GameInfo* info = &gs->gameInfo;
-  ck_assert_ptr_nonnull(info->field);
-  ck_assert_ptr_nonnull(info->next);
-  TetrominoPoints tetromino = spawnTetromino(info, 3, 0, 0, 0);  // I-tetromino
-  int count = 0;
-  for (int i = 0; i < kFigurePoints; ++i) {
-    if (tetromino.points[i].x >= 0) ++count;
-  }
-  ck_assert_int_eq(count, kFigurePoints);
-  ck_assert_int_eq(info->field[1][3], 1);
-  ck_assert_int_eq(info->field[1][4], 1);
-  ck_assert_int_eq(info->field[1][5], 1);
-  ck_assert_int_eq(info->field[1][6], 1);
-  freeMatrix(info->field, kRow);
-  freeMatrix(info->next, kFigureSize);
+  spawnTetromino(gs, 3, 0, 0, 0);  // I-tetromino
+  ck_assert(gs->pieceActive);
+  ck_assert_int_eq(gs->tetrominoX, 3);
+  ck_assert_int_eq(gs->tetrominoY, 0);
+  ck_assert_int_eq(gs->board[1], 0);  // Not stamped into the board
+  uint16_t rows[kRow] = {0};
+  overlayTetromino(gs, rows);
+  ck_assert_int_eq(rows[1], 0xF << 3);
+  lockTetromino(gs);
+  ck_assert(!gs->pieceActive);
+  ck_assert_int_eq(gs->board[1], 0xF << 3);
 }
 END_TEST
 
@@ -126,17 +162,12 @@ END_TEST
  */
 START_TEST(testGenerateNextTetromino) {
   GameState* gs = initGameState();
-  GameInfo* info = &gs->gameInfo;
-  ck_assert_ptr_nonnull(info->field);
-  ck_assert_ptr_nonnull(info->next);
   int tetrominoType, rotationIndex;
-  generateNextTetromino(info, &tetrominoType, &rotationIndex);
+  generateNextTetromino(gs, &tetrominoType, &rotationIndex);
   ck_assert_int_ge(tetrominoType, 0);
   ck_assert_int_lt(tetrominoType, 7);
   ck_assert_int_eq(rotationIndex, 0);
-  ck_assert(hasNextTetromino(info));
-  freeMatrix(info->field, kRow);
-  freeMatrix(info->next, kFigureSize);
+  ck_assert(hasNextTetromino(gs));
 }
 END_TEST
 
@@ -145,15 +176,10 @@ END_TEST
  */
 START_TEST(testHasNextTetromino) {
   GameState* gs = initGameState();
-  GameInfo* info = &gs->gameInfo;
-  ck_assert_ptr_nonnull(info->field);
-  ck_assert_ptr_nonnull(info->next);
-  ck_assert(!hasNextTetromino(info));  // Empty next
+  ck_assert(!hasNextTetromino(gs));  // Empty next
   int tetrominoType, rotationIndex;
-  generateNextTetromino(info, &tetrominoType, &rotationIndex);
-  ck_assert(hasNextTetromino(info));  // Non-empty next
-  freeMatrix(info->field, kRow);
-  freeMatrix(info->next, kFigureSize);
+  generateNextTetromino(gs, &tetrominoType, &rotationIndex);
+  ck_assert(hasNextTetromino(gs));  // Non-empty next
 }
 END_TEST
 
@@ -162,18 +188,12 @@ END_TEST
  */
 START_TEST(testStartFsm) {
   GameState* gs = initGameState();
-  GameInfo* info = &gs->gameInfo;
-  ck_assert_ptr_nonnull(info->field);
-  ck_assert_ptr_nonnull(info->next);
-  startGame(info);
-  ck_assert_ptr_nonnull(info->field);
-  ck_assert_ptr_nonnull(info->next);
+  GameStats* info = &gs->stats;
+  startGame(gs);
   ck_assert_int_eq(info->score, 0);
   ck_assert_int_eq(info->level, 1);
   ck_assert_int_eq(info->speed, kSpeed);
   ck_assert(!info->pause);
-  freeMatrix(info->field, kRow);
-  freeMatrix(info->next, kFigureSize);
 }
 END_TEST
 
@@ -182,18 +202,12 @@ END_TEST
  */
 START_TEST(testSpawnFsm) {
   GameState* gs = initGameState();
-  GameInfo* info = &gs->gameInfo;
-  ck_assert_ptr_nonnull(info->field);
-  ck_assert_ptr_nonnull(info->next);
-  TetrominoPoints tetromino;
   int tetrominoX, tetrominoY;
   FsmState state = kSpawn;
-  spawnTetrominoState(info, &tetromino, &tetrominoX, &tetrominoY, &state);
+  spawnTetrominoState(gs, &tetrominoX, &tetrominoY, &state);
   ck_assert_int_eq(state, kFalling);
   ck_assert_int_eq(tetrominoX, kCol / 2 - kFigureSize / 2);
   ck_assert_int_eq(tetrominoY, 0);
-  freeMatrix(info->field, kRow);
-  freeMatrix(info->next, kFigureSize);
 }
 END_TEST
 
@@ -202,20 +216,11 @@ END_TEST
  */
 START_TEST(testFallingFsm) {
   GameState* gs = initGameState();
-  GameInfo* info = &gs->gameInfo;
-  ck_assert_ptr_nonnull(info->field);
-  ck_assert_ptr_nonnull(info->next);
-  TetrominoPoints tetromino =
-      spawnTetromino(info, 3, kRow - 2, 0, 0);  // I-tetromino near bottom
-  gs->currentTetromino = tetromino;
-  gs->tetrominoX = 3;
-  gs->tetrominoY = kRow - 2;
+  spawnTetromino(gs, 3, kRow - 2, 0, 0);  // I-tetromino near bottom
   FsmState state = kFalling;
-  fallingTetrominoState(info, &tetromino, &state);
+  fallingTetrominoState(gs, &state);
   ck_assert_int_eq(state, kLocking);  // Hits bottom
-  ck_assert_int_eq(tetromino.points[0].y, kRow - 1);
-  freeMatrix(info->field, kRow);
-  freeMatrix(info->next, kFigureSize);
+  ck_assert_int_eq(gs->tetrominoY, kRow - 2);
 }
 END_TEST
 
@@ -224,19 +229,12 @@ END_TEST
  */
 START_TEST(testMovingFsm) {
   GameState* gs = initGameState();
-  GameInfo* info = &gs->gameInfo;
-  ck_assert_ptr_nonnull(info->field);
-  ck_assert_ptr_nonnull(info->next);
-  TetrominoPoints tetromino = spawnTetromino(info, 3, 0, 0, 0);  // I-tetromino
-  gs->currentTetromino = tetromino;
-  gs->tetrominoX = 3;
+  spawnTetromino(gs, 3, 0, 0, 0);  // I-tetromino
   FsmState state = kMoving;
   int tetrominoX = 3;
-  movingTetrominoState(info, &tetromino, &state, &tetrominoX, kActionRight);
+  movingTetrominoState(gs, &state, &tetrominoX, kActionRight);
   ck_assert_int_eq(state, kFalling);
   ck_assert_int_eq(tetrominoX, 4);
-  freeMatrix(info->field, kRow);
-  freeMatrix(info->next, kFigureSize);
 }
 END_TEST
 
@@ -245,20 +243,10 @@ END_TEST
  */
 START_TEST(testRotateTetromino) {
   GameState* gs = initGameState();
-  GameInfo* info = &gs->gameInfo;
-  ck_assert_ptr_nonnull(info->field);
-  ck_assert_ptr_nonnull(info->next);
-  gs->tetrominoType = 0;  // I-tetromino
-  gs->rotationIndex = 0;
-  gs->tetrominoX = 3;
-  gs->tetrominoY = 0;
-  TetrominoPoints tetromino = spawnTetromino(info, 3, 0, 0, 0);
-  gs->currentTetromino = tetromino;
-  rotateTetromino(info, &tetromino);
+  spawnTetromino(gs, 3, 0, 0, 0);  // I-tetromino
+  rotateTetromino(gs);
   ck_assert_int_eq(gs->rotationIndex, 1);
-  ck_assert_int_eq(tetromino.points[0].y, 0);
-  freeMatrix(info->field, kRow);
-  freeMatrix(info->next, kFigureSize);
+  ck_assert_int_eq(gs->tetrominoY, 0);
 }
 END_TEST
 
@@ -267,19 +255,13 @@ END_TEST
  */
 START_TEST(testClearingFsm) {
   GameState* gs = initGameState();
-  GameInfo* info = &gs->gameInfo;
-  ck_assert_ptr_nonnull(info->field);
-  ck_assert_ptr_nonnull(info->next);
-  for (int x = 0; x < kCol; ++x) {
-    info->field[kRow - 1][x] = 1;  // Fill bottom row
-  }
+  GameStats* info = &gs->stats;
+  gs->board[kRow - 1] = kFullRow;  // Fill bottom row
   FsmState state = kClearing;
-  clearLinesState(info, &state);
+  clearLinesState(gs, &state);
   ck_assert_int_eq(state, kSpawn);
   ck_assert_int_eq(info->score, kScoreSingleLine);
   ck_assert_int_eq(info->level, 1);
-  freeMatrix(info->field, kRow);
-  freeMatrix(info->next, kFigureSize);
 }
 END_TEST
 
@@ -288,16 +270,12 @@ END_TEST
  */
 START_TEST(testGameOverFsm) {
   GameState* gs = initGameState();
-  GameInfo* info = &gs->gameInfo;
-  ck_assert_ptr_nonnull(info->field);
-  ck_assert_ptr_nonnull(info->next);
+  GameStats* info = &gs->stats;
   info->score = 500;
   info->high_score = 200;
-  gameOverState(info);
+  gameOverState(gs);
   ck_assert_int_eq(info->pause, -1);
   ck_assert_int_eq(info->high_score, 500);  // Updated high score
-  freeMatrix(info->field, kRow);
-  freeMatrix(info->next, kFigureSize);
 }
 END_TEST
 
@@ -306,9 +284,7 @@ END_TEST
  */
 START_TEST(testUserInput) {
   GameState* gs = initGameState();
-  GameInfo* info = &gs->gameInfo;
-  ck_assert_ptr_nonnull(info->field);
-  ck_assert_ptr_nonnull(info->next);
+  GameStats* info = &gs->stats;
   userInput(kActionStart, false);
   ck_assert_int_eq(gs->state, kSpawn);
   userInput(kActionPause, false);
@@ -320,8 +296,6 @@ START_TEST(testUserInput) {
   userInput(kActionTerminate, false);
   ck_assert_int_eq(gs->state, kGameOver);
   ck_assert_int_eq(info->pause, -1);
-  freeMatrix(info->field, kRow);
-  freeMatrix(info->next, kFigureSize);
 }
 END_TEST
 
@@ -331,17 +305,14 @@ END_TEST
 START_TEST(testUserInputMovement) {
   // Test kActionRight: kFalling -> kMoving -> kFalling
   GameState* gs = initGameState();
-  GameInfo* info = &gs->gameInfo;
-  ck_assert_ptr_nonnull(info->field);
-  ck_assert_ptr_nonnull(info->next);
-  for (int i = 0; i < kRow; ++i) {
-    for (int j = 0; j < kCol; ++j) {
-      info->field[i][j] = 0;  // Clear field
-    }
-  }
+  GameStats* info = &gs->stats;
+  memset(gs->board, 0, sizeof(gs->board));  // Clear field
   userInput(kActionStart, false);  // kStart -> kSpawn
   updateCurrentState();            // kSpawn -> kFalling
-  gs->currentTetromino = spawnTetromino(info, 4, 0, 0, 0);  // I-tetromino
+  memset(gs->board, 0, sizeof(gs->board));  // Remove the spawned piece
+  gs->tetrominoType = 0;
+  gs->rotationIndex = 0;
+  spawnTetromino(gs, 4, 0, 0, 0);  // I-tetromino
   gs->tetrominoX = 4;
   gs->tetrominoY = 0;
   gs->state = kFalling;
@@ -349,24 +320,20 @@ START_TEST(testUserInputMovement) {
   ck_assert_int_eq(gs->state, kMoving);
   ck_assert_int_eq(gs->moveDirection, kActionRight);
   updateCurrentState();  // Process kMoving
-  ck_assert_int_eq(gs->state, kLocking);
+  ck_assert_int_eq(gs->state, kFalling);
   ck_assert_int_eq(gs->tetrominoX, 5);
-  freeMatrix(info->field, kRow);
-  freeMatrix(info->next, kFigureSize);
+  ck_assert_int_eq(gs->tetrominoY, 1);
 
   // Test kActionLeft: kFalling -> kMoving -> kFalling
   gs = initGameState();
-  info = &gs->gameInfo;
-  ck_assert_ptr_nonnull(info->field);
-  ck_assert_ptr_nonnull(info->next);
-  for (int i = 0; i < kRow; ++i) {
-    for (int j = 0; j < kCol; ++j) {
-      info->field[i][j] = 0;
-    }
-  }
+  info = &gs->stats;
+  memset(gs->board, 0, sizeof(gs->board));
   userInput(kActionStart, false);
   updateCurrentState();
-  gs->currentTetromino = spawnTetromino(info, 4, 0, 0, 0);
+  memset(gs->board, 0, sizeof(gs->board));  // Remove the spawned piece
+  gs->tetrominoType = 0;
+  gs->rotationIndex = 0;
+  spawnTetromino(gs, 4, 0, 0, 0);
   gs->tetrominoX = 4;
   gs->tetrominoY = 0;
   gs->state = kFalling;
@@ -376,67 +343,49 @@ START_TEST(testUserInputMovement) {
   updateCurrentState();
   ck_assert_int_eq(gs->state, kFalling);
   ck_assert_int_eq(gs->tetrominoX, 3);
-  freeMatrix(info->field, kRow);
-  freeMatrix(info->next, kFigureSize);
 
-  // Test kActionDown (hold = false): Single step down
+  // Test kActionDown (hold = false): Drop to bottom
   gs = initGameState();
-  info = &gs->gameInfo;
-  ck_assert_ptr_nonnull(info->field);
-  ck_assert_ptr_nonnull(info->next);
-  for (int i = 0; i < kRow; ++i) {
-    for (int j = 0; j < kCol; ++j) {
-      info->field[i][j] = 0;
-    }
-  }
+  info = &gs->stats;
+  memset(gs->board, 0, sizeof(gs->board));
   userInput(kActionStart, false);
   updateCurrentState();
-  gs->currentTetromino = spawnTetromino(info, 4, 0, 0, 0);
+  memset(gs->board, 0, sizeof(gs->board));  // Remove the spawned piece
+  gs->tetrominoType = 0;
+  gs->rotationIndex = 0;
+  spawnTetromino(gs, 4, 0, 0, 0);
   gs->tetrominoX = 4;
   gs->tetrominoY = 0;
   gs->state = kFalling;
   userInput(kActionDown, false);
   ck_assert_int_eq(gs->state, kLocking);
   updateCurrentState();
-  ck_assert_int_eq(gs->tetrominoY, 0);
-  freeMatrix(info->field, kRow);
-  freeMatrix(info->next, kFigureSize);
+  ck_assert_int_eq(gs->tetrominoY, kRow - 2);
 
   // Test kActionDown (hold = true): Drop to bottom
   gs = initGameState();
-  info = &gs->gameInfo;
-  ck_assert_ptr_nonnull(info->field);
-  ck_assert_ptr_nonnull(info->next);
-  for (int i = 0; i < kRow; ++i) {
-    for (int j = 0; j < kCol; ++j) {
-      info->field[i][j] = 0;
-    }
-  }
+  info = &gs->stats;
+  memset(gs->board, 0, sizeof(gs->board));
   userInput(kActionStart, false);
   updateCurrentState();
-  gs->currentTetromino = spawnTetromino(info, 4, 0, 0, 0);
+  memset(gs->board, 0, sizeof(gs->board));  // Remove the spawned piece
+  gs->tetrominoType = 0;
+  gs->rotationIndex = 0;
+  spawnTetromino(gs, 4, 0, 0, 0);
   gs->tetrominoX = 4;
   gs->tetrominoY = 0;
   gs->state = kFalling;
   userInput(kActionDown, true);
   ck_assert_int_eq(gs->state, kLocking);
-  ck_assert_int_eq(gs->currentTetromino.points[0].y, kRow - 1);
-  freeMatrix(info->field, kRow);
-  freeMatrix(info->next, kFigureSize);
+  ck_assert_int_eq(gs->tetrominoY, kRow - 2);
 
   // Test kActionRotate: Rotate figure
   gs = initGameState();
-  info = &gs->gameInfo;
-  ck_assert_ptr_nonnull(info->field);
-  ck_assert_ptr_nonnull(info->next);
-  for (int i = 0; i < kRow; ++i) {
-    for (int j = 0; j < kCol; ++j) {
-      info->field[i][j] = 0;
-    }
-  }
+  info = &gs->stats;
+  memset(gs->board, 0, sizeof(gs->board));
   userInput(kActionStart, false);
   updateCurrentState();
-  gs->currentTetromino = spawnTetromino(info, 4, 2, 0, 0);  // I-tetromino
+  spawnTetromino(gs, 4, 2, 0, 0);  // I-tetromino
   gs->tetrominoX = 4;
   gs->tetrominoY = 2;
   gs->tetrominoType = 0;
@@ -445,19 +394,11 @@ START_TEST(testUserInputMovement) {
   userInput(kActionRotate, false);
   ck_assert_int_eq(gs->state, kFalling);
   ck_assert_int_eq(gs->rotationIndex, 1);
-  freeMatrix(info->field, kRow);
-  freeMatrix(info->next, kFigureSize);
 
   // Test ignoring actions when paused
   gs = initGameState();
-  info = &gs->gameInfo;
-  ck_assert_ptr_nonnull(info->field);
-  ck_assert_ptr_nonnull(info->next);
-  for (int i = 0; i < kRow; ++i) {
-    for (int j = 0; j < kCol; ++j) {
-      info->field[i][j] = 0;
-    }
-  }
+  info = &gs->stats;
+  memset(gs->board, 0, sizeof(gs->board));
   userInput(kActionStart, false);
   updateCurrentState();
   info->pause = 1;  // Paused
@@ -470,19 +411,11 @@ START_TEST(testUserInputMovement) {
   ck_assert_int_eq(gs->state, kFalling);
   userInput(kActionRotate, false);
   ck_assert_int_eq(gs->state, kFalling);
-  freeMatrix(info->field, kRow);
-  freeMatrix(info->next, kFigureSize);
 
   // Test ignoring actions in kStart
   gs = initGameState();
-  info = &gs->gameInfo;
-  ck_assert_ptr_nonnull(info->field);
-  ck_assert_ptr_nonnull(info->next);
-  for (int i = 0; i < kRow; ++i) {
-    for (int j = 0; j < kCol; ++j) {
-      info->field[i][j] = 0;
-    }
-  }
+  info = &gs->stats;
+  memset(gs->board, 0, sizeof(gs->board));
   info->pause = 0;
   gs->state = kStart;
   userInput(kActionRight, false);
@@ -493,19 +426,11 @@ START_TEST(testUserInputMovement) {
   ck_assert_int_eq(gs->state, kStart);
   userInput(kActionRotate, false);
   ck_assert_int_eq(gs->state, kStart);
-  freeMatrix(info->field, kRow);
-  freeMatrix(info->next, kFigureSize);
 
   // Test ignoring actions when game over
   gs = initGameState();
-  info = &gs->gameInfo;
-  ck_assert_ptr_nonnull(info->field);
-  ck_assert_ptr_nonnull(info->next);
-  for (int i = 0; i < kRow; ++i) {
-    for (int j = 0; j < kCol; ++j) {
-      info->field[i][j] = 0;
-    }
-  }
+  info = &gs->stats;
+  memset(gs->board, 0, sizeof(gs->board));
   userInput(kActionStart, false);
   updateCurrentState();
   info->pause = -1;  // Game over
@@ -518,102 +443,76 @@ START_TEST(testUserInputMovement) {
   ck_assert_int_eq(gs->state, kGameOver);
   userInput(kActionRotate, false);
   ck_assert_int_eq(gs->state, kGameOver);
-  freeMatrix(info->field, kRow);
-  freeMatrix(info->next, kFigureSize);
 }
 END_TEST
 
+// Calls issued by the first frame before the overlay: right border, bottom
+// border, label, one span per field row and preview row, three stats.
+enum { kFirstFrameCalls = kRow + 1 + 1 + kRow + kFigureSize + 3 };
+
+/**
+ * Checks one recorded drawing call.
+ */
+static void assertCall(int idx, int y, int x, const char* str) {
+  ck_assert_int_eq(mock.calls[idx].y, y);
+  ck_assert_int_eq(mock.calls[idx].x, x);
+  ck_assert_str_eq(mock.calls[idx].str, str);
+}
+
 /**
- * Tests renderField with an empty field and active game.
+ * Tests that the first frame paints the whole screen.
  */
 START_TEST(testRenderFieldActive) {
-  GameState* gs = initGameState();
-  GameInfo* info = &gs->gameInfo;
-  ck_assert_ptr_nonnull(info->field);
-  ck_assert_ptr_nonnull(info->next);
-
-  // Set up game info
-  info->score = 100;
-  info->high_score = 500;
-  info->level = 2;
-  info->pause = 0;
+  TetrisFrame frame = {.score = 100, .highScore = 500, .level = 2};
   // Set I-tetromino in next
-  for (int i = 0; i < kFigureSize; ++i) {
-    for (int j = 0; j < kFigureSize; ++j) {
-      info->next[i][j] = kTetrominoShapes[0][0][i][j];  // I-tetromino
-    }
-  }
+  memcpy(frame.next, kPieceMasks[0][0].rows, sizeof(frame.next));
 
-  renderField(*info);
+  invalidateRender();
+  renderField(&frame);
 
-  // Check field rendering (empty field)
   int call_idx = 0;
-  for (int i = 0; i < kRow; ++i) {
-    for (int j = 0; j < kCol; ++j) {
-      ck_assert_int_eq(mock.calls[call_idx].y, i);
-      ck_assert_int_eq(mock.calls[call_idx].x, j);
-      ck_assert_str_eq(mock.calls[call_idx].str, " ");
-      call_idx++;
-    }
-  }
-
   // Check right border
   for (int i = 0; i < kRow; ++i) {
-    ck_assert_int_eq(mock.calls[call_idx].y, i);
-    ck_assert_int_eq(mock.calls[call_idx].x, kCol);
-    ck_assert_str_eq(mock.calls[call_idx].str, "|");
-    call_idx++;
+    assertCall(call_idx++, i, kCol, "|");
   }
 
   // Check bottom border
-  for (int i = 0; i < kCol + 1; ++i) {
-    ck_assert_int_eq(mock.calls[call_idx].y, kRow);
-    ck_assert_int_eq(mock.calls[call_idx].x, i);
-    ck_assert_str_eq(mock.calls[call_idx].str, "-");
-    call_idx++;
-  }
+  char border[kCol + 2];
+  memset(border, '-', kCol + 1);
+  border[kCol + 1] = '\0';
+  assertCall(call_idx++, kRow, 0, border);
 
   // Check "Next" label
-  ck_assert_int_eq(mock.calls[call_idx].y, 0);
-  ck_assert_int_eq(mock.calls[call_idx].x, kCol + 3);
-  ck_assert_str_eq(mock.calls[call_idx].str, "Next");
-  call_idx++;
+  assertCall(call_idx++, 0, kCol + 3, "Next");
+
+  // Check field rendering (empty field, one span per row)
+  char blank[kCol + 1];
+  memset(blank, ' ', kCol);
+  blank[kCol] = '\0';
+  for (int i = 0; i < kRow; ++i) {
+    assertCall(call_idx++, i, 0, blank);
+  }
 
   // Check next tetromino (I-tetromino)
   for (int i = 0; i < kFigureSize; ++i) {
+    char row[kFigureSize + 1] = {0};
     for (int j = 0; j < kFigureSize; ++j) {
-      ck_assert_int_eq(mock.calls[call_idx].y, i + 2);
-      ck_assert_int_eq(mock.calls[call_idx].x, j + kCol + 3);
-      ck_assert_str_eq(mock.calls[call_idx].str,
-                       kTetrominoShapes[0][0][i][j] ? "o" : " ");
-      call_idx++;
+      row[j] = kTetrominoShapes[0][0][i][j] ? 'o' : ' ';
     }
+    assertCall(call_idx++, i + 2, kCol + 3, row);
   }
 
   // Check stats
-  ck_assert_int_eq(mock.calls[call_idx].y, 6);
-  ck_assert_int_eq(mock.calls[call_idx].x, kCol + 3);
-  ck_assert_str_eq(mock.calls[call_idx].str, "Level: 2");
-  call_idx++;
-
-  ck_assert_int_eq(mock.calls[call_idx].y, 7);
-  ck_assert_int_eq(mock.calls[call_idx].x, kCol + 3);
-  ck_assert_str_eq(mock.calls[call_idx].str, "Score: 100");
-  call_idx++;
-
-  ck_assert_int_eq(mock.calls[call_idx].y, 8);
-  ck_assert_int_eq(mock.calls[call_idx].x, kCol + 3);
-  ck_assert_str_eq(mock.calls[call_idx].str, "High Score: 500");
-  call_idx++;
+  assertCall(call_idx++, 6, kCol + 3, "Level: 2         ");
+  assertCall(call_idx++, 7, kCol + 3, "Score: 100       ");
+  assertCall(call_idx++, 8, kCol + 3, "High Score: 500       ");
 
   // No pause or game over message
+  ck_assert_int_eq(call_idx, kFirstFrameCalls);
   ck_assert_int_eq(mock.call_count, call_idx);
 
   // Check refresh
   ck_assert_int_eq(mock.refresh_count, 0);
-
-  freeMatrix(info->field, kRow);
-  freeMatrix(info->next, kFigureSize);
 }
 END_TEST
 
@@ -621,37 +520,35 @@ END_TEST
  * Tests renderField with a paused game.
  */
 START_TEST(testRenderFieldPaused) {
-  GameState* gs = initGameState();
-  GameInfo* info = &gs->gameInfo;
-  ck_assert_ptr_nonnull(info->field);
-  ck_assert_ptr_nonnull(info->next);
-
-  // Set up game info
-  info->score = 0;
-  info->high_score = 0;
-  info->level = 1;
-  info->pause = 1;  // Paused
+  TetrisFrame frame = {.level = 1, .pause = 1};
 
-  renderField(*info);
+  invalidateRender();
+  renderField(&frame);
 
   // Skip checking field, borders, next, and stats (same as active)
-  int call_idx =
-      kRow * kCol + kRow + (kCol + 1) + 1 + kFigureSize * kFigureSize + 3;
+  int call_idx = kFirstFrameCalls;
 
   // Check "PAUSED" message
-  ck_assert_int_eq(mock.calls[call_idx].y, kRow / 2);
-  ck_assert_int_eq(mock.calls[call_idx].x, kCol / 2 - 3);
-  ck_assert_str_eq(mock.calls[call_idx].str, "PAUSED");
-  call_idx++;
+  assertCall(call_idx++, kRow / 2, kCol / 2 - 3, "PAUSED");
 
   // No game over message
   ck_assert_int_eq(mock.call_count, call_idx);
 
-  // Check refresh
-  ck_assert_int_eq(mock.refresh_count, 0);
+  // Unpausing repaints the banner row only
+  resetMock();
+  frame.pause = 0;
+  renderField(&frame);
+  ck_assert_int_eq(mock.call_count, 1);
+  ck_assert_int_eq(mock.calls[0].y, kRow / 2);
+  ck_assert_int_eq(mock.calls[0].x, 0);
 
-  freeMatrix(info->field, kRow);
-  freeMatrix(info->next, kFigureSize);
+  // Pausing again restores the banner over the repainted row
+  resetMock();
+  frame.pause = 1;
+  renderField(&frame);
+  ck_assert_int_eq(mock.call_count, 2);
+  ck_assert_int_eq(mock.calls[0].y, kRow / 2);
+  assertCall(1, kRow / 2, kCol / 2 - 3, "PAUSED");
 }
 END_TEST
 
@@ -659,37 +556,19 @@ END_TEST
  * Tests renderField with game over.
  */
 START_TEST(testRenderFieldGameOver) {
-  GameState* gs = initGameState();
-  GameInfo* info = &gs->gameInfo;
-  ck_assert_ptr_nonnull(info->field);
-  ck_assert_ptr_nonnull(info->next);
-
-  // Set up game info
-  info->score = 0;
-  info->high_score = 0;
-  info->level = 1;
-  info->pause = -1;  // Game over
+  TetrisFrame frame = {.level = 1, .pause = -1};
 
-  renderField(*info);
+  invalidateRender();
+  renderField(&frame);
 
   // Skip checking field, borders, next, and stats
-  int call_idx =
-      kRow * kCol + kRow + (kCol + 1) + 1 + kFigureSize * kFigureSize + 3;
+  int call_idx = kFirstFrameCalls;
 
   // Check "GAME OVER" message
-  ck_assert_int_eq(mock.calls[call_idx].y, kRow / 2);
-  ck_assert_int_eq(mock.calls[call_idx].x, kCol / 2 - 5);
-  ck_assert_str_eq(mock.calls[call_idx].str, "GAME OVER");
-  call_idx++;
+  assertCall(call_idx++, kRow / 2, kCol / 2 - 5, "GAME OVER");
 
   // No pause message
   ck_assert_int_eq(mock.call_count, call_idx);
-
-  // Check refresh
-  ck_assert_int_eq(mock.refresh_count, 0);
-
-  freeMatrix(info->field, kRow);
-  freeMatrix(info->next, kFigureSize);
 }
 END_TEST
 
@@ -698,47 +577,1187 @@ END_TEST
  */
 START_TEST(testRenderFieldNonEmpty) {
   GameState* gs = initGameState();
-  GameInfo* info = &gs->gameInfo;
-  ck_assert_ptr_nonnull(info->field);
-  ck_assert_ptr_nonnull(info->next);
-
-  // Set up game info
-  info->score = 0;
-  info->high_score = 0;
-  info->level = 1;
-  info->pause = 0;
+
   // Place I-tetromino on field
-  spawnTetromino(info, 3, 0, 0, 0);  // I-tetromino
+  spawnTetromino(gs, 3, 0, 0, 0);  // I-tetromino
 
-  renderField(*info);
+  invalidateRender();
+  renderField(tetris_publishFrame(getDefaultGame()));
 
-  // Check field rendering (I-tetromino at y=1, x=3,4,5,6)
-  int call_idx = 0;
+  // Check field rendering (I-tetromino at y=1, x=3,4,5,6, ghost below)
+  int call_idx = kRow + 1 + 1;
   for (int i = 0; i < kRow; ++i) {
+    char row[kCol + 1] = {0};
     for (int j = 0; j < kCol; ++j) {
-      ck_assert_int_eq(mock.calls[call_idx].y, i);
-      ck_assert_int_eq(mock.calls[call_idx].x, j);
-      if (i == 1 && (j >= 3 && j <= 6)) {
-        ck_assert_str_eq(mock.calls[call_idx].str, "o");
-      } else {
-        ck_assert_str_eq(mock.calls[call_idx].str, " ");
+      bool piece = j >= 3 && j <= 6;
+      row[j] = i == 1 && piece ? 'o' : (i == kRow - 1 && piece ? '.' : ' ');
+    }
+    assertCall(call_idx++, i, 0, row);
+  }
+
+  // No pause or game over message
+  ck_assert_int_eq(mock.call_count, kFirstFrameCalls);
+
+}
+END_TEST
+
+/**
+ * Tests that later frames repaint only the cells and values that changed.
+ */
+START_TEST(testRenderFieldDirtyRegions) {
+  TetrisFrame frame = {.level = 1};
+
+  invalidateRender();
+  renderField(&frame);
+
+  // Unchanged frame draws nothing
+  resetMock();
+  renderField(&frame);
+  ck_assert_int_eq(mock.call_count, 0);
+
+  // Moving the I-tetromino one column repaints the two cells at its ends
+  frame.field[1] = 0xF << 3;
+  renderField(&frame);
+  resetMock();
+  frame.field[1] = 0xF << 4;
+  renderField(&frame);
+  ck_assert_int_eq(mock.call_count, 1);
+  assertCall(0, 1, 3, " oooo");
+
+  // A single changed cell is drawn on its own
+  resetMock();
+  frame.field[kRow - 1] |= 1 << 9;
+  renderField(&frame);
+  ck_assert_int_eq(mock.call_count, 1);
+  assertCall(0, kRow - 1, 9, "o");
+
+  // Only the changed stat is reprinted, padded over the old value
+  resetMock();
+  frame.score = 1500;
+  renderField(&frame);
+  ck_assert_int_eq(mock.call_count, 1);
+  assertCall(0, 7, kCol + 3, "Score: 1500      ");
+
+  // A new next piece repaints the preview rows that differ
+  resetMock();
+  frame.next[1] = 0x1;
+  renderField(&frame);
+  ck_assert_int_eq(mock.call_count, 1);
+  assertCall(0, 3, kCol + 3, "o");
+}
+END_TEST
+
+/**
+ * Tests that frames are double-buffered snapshots of the game.
+ */
+START_TEST(testPublishFrame) {
+  TetrisGame* game = tetris_create();
+  ck_assert_ptr_nonnull(game);
+  ck_assert_int_eq(tetris_currentFrame(game)->seq, 0);
+
+  tetris_userInput(game, kActionStart, false);
+  tetris_updateCurrentState(game);
+  const TetrisFrame* first = tetris_currentFrame(game);
+  ck_assert_int_eq(first->seq, 1);
+  uint16_t expected[kRow];
+  memcpy(expected, game->state.board, sizeof(expected));
+  overlayTetromino(&game->state, expected);
+  ck_assert_mem_eq(first->field, expected, sizeof(first->field));
+  ck_assert_mem_eq(first->next,
+                   kPieceMasks[game->state.nextTetrominoType][0].rows,
+                   sizeof(first->next));
+  ck_assert_int_eq(first->level, 1);
+  ck_assert_int_eq(first->speed, kSpeed);
+
+  // The previous frame survives the next publish untouched
+  uint16_t before[kRow];
+  memcpy(before, first->field, sizeof(before));
+  game->state.board[kRow - 1] = kFullRow >> 1;
+  game->state.stats.score = 300;
+  const TetrisFrame* second = tetris_publishFrame(game);
+  ck_assert_ptr_ne(second, first);
+  ck_assert_ptr_eq(tetris_currentFrame(game), second);
+  ck_assert_int_eq(second->seq, 2);
+  ck_assert_int_eq(second->score, 300);
+  ck_assert_uint_eq(second->field[kRow - 1], kFullRow >> 1);
+  ck_assert_mem_eq(first->field, before, sizeof(before));
+  ck_assert_int_eq(first->score, 0);
+
+  tetris_destroy(game);
+}
+END_TEST
+
+/**
+ * Tests copying the bitboard into the GameInfo.field view.
+ */
+START_TEST(testSyncFieldView) {
+  GameState* gs = initGameState();
+  GameInfo view = {.field = allocMatrix(kRow, kCol),
+                   .next = allocMatrix(kFigureSize, kFigureSize)};
+  gs->board[kRow - 1] = 0x201;  // Columns 0 and 9.
+  gs->board[3] = 0x010;         // Column 4.
+  gs->nextTetrominoType = 0;    // I
+  gs->stats.score = 700;
+  syncFieldView(gs, &view);
+  for (int i = 0; i < kRow; ++i) {
+    for (int j = 0; j < kCol; ++j) {
+      int expected = (i == kRow - 1 && (j == 0 || j == kCol - 1)) ||
+                     (i == 3 && j == 4);
+      ck_assert_int_eq(view.field[i][j], expected);
+    }
+  }
+  for (int i = 0; i < kFigureSize; ++i) {
+    for (int j = 0; j < kFigureSize; ++j) {
+      ck_assert_int_eq(view.next[i][j], kTetrominoShapes[0][0][i][j]);
+    }
+  }
+  ck_assert_int_eq(view.score, 700);
+  freeMatrix(view.field, kRow);
+  freeMatrix(view.next, kFigureSize);
+}
+END_TEST
+
+/**
+ * Tests that clearing two lines shifts the rows above them down.
+ */
+START_TEST(testClearingShiftsRows) {
+  GameState* gs = initGameState();
+  GameStats* info = &gs->stats;
+  gs->board[kRow - 1] = kFullRow;
+  gs->board[kRow - 2] = 0x0F0;
+  gs->board[kRow - 3] = kFullRow;
+  gs->board[kRow - 4] = 0x001;
+  FsmState state = kClearing;
+  clearLinesState(gs, &state);
+  ck_assert_int_eq(state, kSpawn);
+  ck_assert_int_eq(info->score, kScoreDoubleLine);
+  ck_assert_int_eq(gs->board[kRow - 1], 0x0F0);
+  ck_assert_int_eq(gs->board[kRow - 2], 0x001);
+  ck_assert_int_eq(gs->board[kRow - 3], 0);
+}
+END_TEST
+
+/**
+ * Tests that the packed piece masks agree with kTetrominoShapes.
+ */
+START_TEST(testPieceMasksMatchShapes) {
+  const int* rotations = getRotationsPerTetromino();
+  for (int type = 0; type < 7; ++type) {
+    for (int rot = 0; rot < rotations[type]; ++rot) {
+      const PieceMask* piece = &kPieceMasks[type][rot];
+      const int(*shape)[kFigureSize] = kTetrominoShapes[type][rot];
+      int minX = kFigureSize, maxX = -1, minY = kFigureSize, maxY = -1;
+      for (int i = 0; i < kFigureSize; ++i) {
+        int left = -1, right = -1, bottom = -1;
+        for (int j = 0; j < kFigureSize; ++j) {
+          ck_assert_int_eq((piece->rows[i] >> j) & 1, shape[i][j]);
+          if (shape[i][j]) {
+            if (left == -1) left = j;
+            right = j;
+            minX = j < minX ? j : minX;
+            maxX = j > maxX ? j : maxX;
+            minY = i < minY ? i : minY;
+            maxY = i > maxY ? i : maxY;
+          }
+          if (shape[j][i]) bottom = j;
+        }
+        ck_assert_int_eq(piece->leftSkirt[i], left);
+        ck_assert_int_eq(piece->rightSkirt[i], right);
+        ck_assert_int_eq(piece->bottomSkirt[i], bottom);
       }
-      call_idx++;
+      ck_assert_int_eq(piece->left, minX);
+      ck_assert_int_eq(piece->top, minY);
+      ck_assert_int_eq(piece->width, maxX - minX + 1);
+      ck_assert_int_eq(piece->height, maxY - minY + 1);
+      ck_assert_int_eq(piece->spawnX, kCol / 2 - kFigureSize / 2);
+      ck_assert_int_eq(piece->spawnY, 0);
     }
   }
+}
+END_TEST
 
-  // Skip checking borders, next, and stats (same as active)
-  call_idx =
-      kRow * kCol + kRow + (kCol + 1) + 1 + kFigureSize * kFigureSize + 3;
+/**
+ * Tests the collision kernel against walls, floor and occupied cells.
+ */
+START_TEST(testFits) {
+  GameState* gs = initGameState();
+  ck_assert(fits(gs, 0, 1, -2, 0));
+  ck_assert(!fits(gs, 0, 1, -3, 0));
+  ck_assert(fits(gs, 0, 1, kCol - 3, kRow - 4));
+  ck_assert(!fits(gs, 0, 1, kCol - 2, 0));
+  ck_assert(!fits(gs, 0, 1, 0, kRow - 3));
+  gs->board[kRow - 1] = 1u << 4;
+  ck_assert(!fits(gs, 0, 1, 2, kRow - 4));
+  ck_assert(fits(gs, 0, 1, 3, kRow - 4));
+}
+END_TEST
 
-  // No pause or game over message
-  ck_assert_int_eq(mock.call_count, call_idx);
+/**
+ * Tests clearing four non-adjacent full rows in a single pass.
+ */
+START_TEST(testClearingTetris) {
+  GameState* gs = initGameState();
+  GameStats* info = &gs->stats;
+  for (int y = kRow - 8; y < kRow; ++y) {
+    gs->board[y] = (y % 2) ? kFullRow : (uint16_t)(1u << (y - (kRow - 8)));
+  }
+  FsmState state = kClearing;
+  clearLinesState(gs, &state);
+  ck_assert_int_eq(state, kSpawn);
+  ck_assert_int_eq(info->score, kScoreTetris);
+  for (int i = 0; i < 4; ++i) {
+    ck_assert_int_eq(gs->board[kRow - 1 - i], 1u << (6 - 2 * i));
+  }
+  for (int y = 0; y < kRow - 4; ++y) {
+    ck_assert_int_eq(gs->board[y], 0);
+  }
+}
+END_TEST
 
-  // Check refresh
-  ck_assert_int_eq(mock.refresh_count, 0);
+/**
+ * Tests that separate game instances do not share state.
+ */
+START_TEST(testMultipleInstances) {
+  TetrisGame* first = tetris_create();
+  TetrisGame* second = tetris_create();
+  ck_assert_ptr_nonnull(first);
+  ck_assert_ptr_nonnull(second);
+  ck_assert_ptr_ne(first, second);
+  ck_assert_int_eq(first->state.state, kStart);
+  tetris_userInput(first, kActionStart, false);
+  tetris_updateCurrentState(first);  // kSpawn -> kFalling
+  ck_assert_int_eq(first->state.state, kFalling);
+  ck_assert_int_eq(second->state.state, kStart);
+  ck_assert_int_eq(getGameState()->state, kStart);
+  tetris_userInput(second, kActionStart, false);
+  tetris_userInput(first, kActionDown, false);
+  ck_assert_int_eq(first->state.state, kLocking);
+  ck_assert_int_eq(second->state.state, kSpawn);
+  GameInfo info = tetris_updateCurrentState(first);
+  ck_assert_ptr_eq(info.field, first->view.field);
+  ck_assert_ptr_ne(info.field, second->view.field);
+  tetris_destroy(first);
+  tetris_destroy(second);
+  tetris_destroy(NULL);
+}
+END_TEST
+
+/**
+ * Tests that two instances with the same seed deal the same pieces.
+ */
+START_TEST(testSeededInstancesRepeat) {
+  TetrisGame* first = tetris_create();
+  TetrisGame* second = tetris_create();
+  tetris_seed(first, 42);
+  tetris_seed(second, 42);
+  tetris_userInput(first, kActionStart, false);
+  tetris_userInput(second, kActionStart, false);
+  for (int i = 0; i < 500; ++i) {
+    if (first->state.state == kFalling) {
+      tetris_userInput(first, kActionDown, false);
+      tetris_userInput(second, kActionDown, false);
+    }
+    tetris_tick(first);
+    tetris_tick(second);
+    ck_assert_int_eq(first->state.state, second->state.state);
+    ck_assert_int_eq(first->state.tetrominoType, second->state.tetrominoType);
+  }
+  ck_assert_int_eq(first->state.state, kGameOver);
+  ck_assert_mem_eq(first->state.board, second->state.board,
+                   sizeof(first->state.board));
+  tetris_destroy(first);
+  tetris_destroy(second);
+}
+END_TEST
+
+/**
+ * Tests that instances from tetris_create() leave the high score file alone.
+ */
+START_TEST(testInstanceSkipsHighScoreFile) {
+  TetrisGame* game = tetris_create();
+  tetris_userInput(game, kActionStart, false);
+  game->state.stats.score = 900;
+  tetris_userInput(game, kActionTerminate, false);
+  ck_assert_int_eq(game->state.stats.high_score, 900);
+  ck_assert_ptr_null(fopen(kHighScorePath, "r"));
+  tetris_destroy(game);
+}
+END_TEST
+
+/**
+ * Tests applying several actions in a single batch.
+ */
+START_TEST(testUserInputBatch) {
+  GameState* gs = initGameState();
+  userInput(kActionStart, false);
+  updateCurrentState();
+  memset(gs->board, 0, sizeof(gs->board));  // Remove the spawned piece
+  gs->tetrominoType = 0;
+  gs->rotationIndex = 0;
+  spawnTetromino(gs, 4, 0, 0, 0);  // I-tetromino
+  gs->tetrominoX = 4;
+  gs->tetrominoY = 0;
+  gs->state = kFalling;
+
+  const UserAction moves[] = {kActionLeft, kActionLeft, kActionLeft,
+                              kActionRight};
+  userInputBatch(moves, NULL, 4);
+  ck_assert_int_eq(gs->tetrominoX, 1);  // Three shifts applied
+  ck_assert_int_eq(gs->tetrominoY, 0);  // No gravity step in between
+  ck_assert_int_eq(gs->state, kMoving);
+  ck_assert_int_eq(gs->moveDirection, kActionRight);
+  updateCurrentState();
+  ck_assert_int_eq(gs->tetrominoX, 2);
+  ck_assert_int_eq(gs->tetrominoY, 1);
+  ck_assert_int_eq(gs->board[2], 0);
+  ck_assert_int_eq(tetris_currentFrame(getDefaultGame())->field[2], 0xF << 2);
+
+  const UserAction turnAndDrop[] = {kActionRight, kActionRotate, kActionDown};
+  const bool hold[] = {false, false, true};
+  userInputBatch(turnAndDrop, hold, 3);
+  ck_assert_int_eq(gs->rotationIndex, 1);
+  ck_assert_int_eq(gs->state, kLocking);
+
+  userInputBatch(NULL, NULL, 0);
+  ck_assert_int_eq(gs->state, kLocking);
+  updateCurrentState();  // kLocking -> kClearing
+  for (int y = kRow - 4; y < kRow; ++y) {
+    ck_assert_int_eq(gs->board[y], 1u << 5);
+  }
+}
+END_TEST
+
+/**
+ * Tests that a pending sideways move is applied without a gravity step.
+ */
+START_TEST(testApplyPendingShift) {
+  GameState* gs = initGameState();
+  userInput(kActionStart, false);
+  updateCurrentState();
+  memset(gs->board, 0, sizeof(gs->board));  // Remove the spawned piece
+  gs->tetrominoType = 0;
+  gs->rotationIndex = 0;
+  spawnTetromino(gs, 4, 0, 0, 0);  // I-tetromino
+  gs->tetrominoX = 4;
+  gs->tetrominoY = 0;
+  gs->state = kFalling;
+
+  ck_assert(!tetris_applyPendingShift(getDefaultGame()));
+  userInput(kActionLeft, false);
+  ck_assert(tetris_applyPendingShift(getDefaultGame()));
+  ck_assert_int_eq(gs->tetrominoX, 3);
+  ck_assert_int_eq(gs->tetrominoY, 0);  // No gravity step
+  ck_assert_int_eq(gs->state, kFalling);
+  updateCurrentState();
+  ck_assert_int_eq(gs->tetrominoX, 3);
+  ck_assert_int_eq(gs->tetrominoY, 1);
+}
+END_TEST
+
+/**
+ * Tests that column heights follow locks and line clears.
+ */
+START_TEST(testColumnHeights) {
+  GameState* gs = initGameState();
+  spawnTetromino(gs, 0, kRow - 3, 0, 1);  // Vertical I in column 2
+  lockTetromino(gs);
+  ck_assert_int_eq(gs->columnHeights[2], 3);
+  gs->board[kRow - 1] |= kFullRow & ~(1u << 2);  // Complete the bottom row
+  gs->board[kRow - 5] = 1u << 7;                  // Overhang over a hole
+  gs->columnHeights[7] = 5;
+  FsmState state = kClearing;
+  clearLinesState(gs, &state);
+  ck_assert_int_eq(gs->columnHeights[2], 2);
+  ck_assert_int_eq(gs->columnHeights[7], 4);
+  ck_assert_int_eq(gs->columnHeights[0], 0);
+  uint8_t incremental[kCol];
+  memcpy(incremental, gs->columnHeights, sizeof(incremental));
+  rebuildColumnHeights(gs);
+  ck_assert_mem_eq(incremental, gs->columnHeights, sizeof(incremental));
+}
+END_TEST
+
+/**
+ * Tests the landing row against stepping down with fits() on random
+ * boards, including pieces tucked under overhangs.
+ */
+START_TEST(testLandingRow) {
+  GameState* gs = initGameState();
+  const int* rotations = getRotationsPerTetromino();
+  unsigned int seed = 12345;
+  for (int board = 0; board < 200; ++board) {
+    for (int y = 0; y < kRow; ++y) {
+      gs->board[y] = y < kRow / 3 ? 0 : (uint16_t)(rand_r(&seed) & kFullRow);
+    }
+    rebuildColumnHeights(gs);
+    for (int type = 0; type < 7; ++type) {
+      for (int rot = 0; rot < rotations[type]; ++rot) {
+        for (int x = -3; x < kCol; ++x) {
+          for (int y = 0; y < kRow; ++y) {
+            if (!fits(gs, type, rot, x, y)) continue;
+            int expected = y;
+            while (fits(gs, type, rot, x, expected + 1)) ++expected;
+            ck_assert_int_eq(landingRow(gs, type, rot, x, y), expected);
+          }
+        }
+      }
+    }
+  }
+}
+END_TEST
+
+/**
+ * Tests that the ghost piece follows the cached landing row.
+ */
+START_TEST(testGhostPiece) {
+  GameState* gs = initGameState();
+  TetrisGame* game = getDefaultGame();
+  gs->board[kRow - 1] = 0x0F;  // Columns 0-3 filled
+  rebuildColumnHeights(gs);
+  spawnTetromino(gs, 3, 0, 0, 0);  // I-tetromino over columns 3-6
+  gs->state = kFalling;
+  ck_assert_int_eq(gs->ghostY, kRow - 3);
+  const TetrisFrame* frame = tetris_publishFrame(game);
+  ck_assert_int_eq(frame->ghost[kRow - 2], 0xF << 3);
+  ck_assert_int_eq(frame->ghost[kRow - 1], 0);
+
+  // Moving right clears column 3 and lets the ghost reach the floor
+  userInput(kActionRight, false);
+  updateCurrentState();
+  ck_assert_int_eq(gs->tetrominoX, 4);
+  ck_assert_int_eq(gs->ghostY, kRow - 2);
+  frame = tetris_currentFrame(game);
+  ck_assert_int_eq(frame->ghost[kRow - 1], 0xF << 4);
+  ck_assert_int_eq(frame->ghost[kRow - 2], 0);
+
+  // The drop lands on the ghost, where the ghost is hidden by the piece
+  userInput(kActionDown, false);
+  ck_assert_int_eq(gs->tetrominoY, kRow - 2);
+  frame = tetris_publishFrame(game);
+  ck_assert_int_eq(frame->field[kRow - 1], 0x0F | 0xF << 4);
+  for (int i = 0; i < kRow; ++i) {
+    ck_assert_int_eq(frame->ghost[i], 0);
+  }
+}
+END_TEST
+
+/**
+ * Tests that the seed fully determines the piece sequence.
+ */
+START_TEST(testSeedRepeatsPieces) {
+  TetrisGame* first = tetris_create();
+  TetrisGame* second = tetris_create();
+  TetrisGame* other = tetris_create();
+  tetris_seed(first, 7);
+  tetris_seed(second, 7);
+  tetris_seed(other, 8);
+  int counts[7] = {0};
+  bool differs = false;
+  for (int i = 0; i < 700; ++i) {
+    uint32_t value = randomNext(&first->state.randomState);
+    ck_assert_uint_eq(value, randomNext(&second->state.randomState));
+    differs |= value != randomNext(&other->state.randomState);
+    counts[value % 7]++;
+  }
+  ck_assert(differs);
+  for (int type = 0; type < 7; ++type) {
+    ck_assert_int_gt(counts[type], 50);
+  }
+  tetris_destroy(first);
+  tetris_destroy(second);
+  tetris_destroy(other);
+}
+END_TEST
+
+/**
+ * Tests that the 7-bag randomizer deals every type once per bag.
+ */
+START_TEST(testSevenBag) {
+  GameState* gs = initGameState();
+  tetris_seed(getDefaultGame(), 99);
+  tetris_setRandomizer(getDefaultGame(), kRandomizerBag);
+  for (int bag = 0; bag < 50; ++bag) {
+    unsigned seen = 0;
+    for (int i = 0; i < 7; ++i) {
+      int type, rotation;
+      generateNextTetromino(gs, &type, &rotation);
+      ck_assert_int_ge(type, 0);
+      ck_assert_int_lt(type, 7);
+      ck_assert_uint_eq(seen & (1u << type), 0);
+      seen |= 1u << type;
+    }
+    ck_assert_uint_eq(seen, 0x7F);
+  }
+}
+END_TEST
+
+/**
+ * Plays a game with random inputs, single and batched, on a recording
+ * instance.
+ * @param game The game instance.
+ * @param seed Seed of the input sequence.
+ */
+static void playRandomGame(TetrisGame* game, uint64_t seed, int ticks) {
+  static const UserAction kActions[] = {kActionLeft,  kActionRight,
+                                        kActionRotate, kActionDown,
+                                        kActionPause,  kActionUp};
+  for (int tick = 0; tick < ticks && game->state.state != kGameOver; ++tick) {
+    uint32_t r = randomNext(&seed);
+    UserAction batch[3];
+    bool hold[3];
+    int n = (int)(r % 4);
+    for (int i = 0; i < n; ++i) {
+      batch[i] = kActions[randomNext(&seed) % 6];
+      hold[i] = randomNext(&seed) % 2;
+      // Пауза реже остальных действий, иначе партия почти не идёт.
+      if (batch[i] == kActionPause && randomNext(&seed) % 8) {
+        batch[i] = kActionLeft;
+      }
+    }
+    if (r & 4) {
+      tetris_userInputBatch(game, batch, hold, n);
+    } else {
+      for (int i = 0; i < n; ++i) {
+        tetris_userInput(game, batch[i], hold[i]);
+      }
+    }
+    tetris_tick(game);
+  }
+}
+
+/**
+ * Tests that a recorded game replays bit-exactly.
+ */
+START_TEST(testReplayRoundTrip) {
+  TetrisGame* recorded = tetris_create();
+  tetris_seed(recorded, 2024);
+  tetris_setRandomizer(recorded, kRandomizerBag);
+  ck_assert_int_eq(tetris_startRecording(recorded), 0);
+  ck_assert_int_ne(tetris_startRecording(recorded), 0);
+  tetris_userInput(recorded, kActionStart, false);
+  playRandomGame(recorded, 77, 20000);
+  uint8_t* data = NULL;
+  size_t size = 0;
+  ck_assert_int_eq(tetris_finishRecording(recorded, &data, &size), 0);
+  ck_assert_ptr_null(recorded->recorder);
+  ck_assert_int_gt(size, kReplayHeaderSize);
+
+  TetrisGame* replayed = tetris_create();
+  ReplayResult result;
+  ck_assert_int_eq(tetris_replay(replayed, data, size, &result), 0);
+  ck_assert_int_eq(result.score, recorded->state.stats.score);
+  ck_assert_int_eq(result.expectedScore, result.score);
+  ck_assert_int_eq(result.expectedLines, result.lines);
+  ck_assert_int_eq(replayed->state.state, recorded->state.state);
+  ck_assert_int_eq(replayed->state.tetrominoX, recorded->state.tetrominoX);
+  ck_assert_int_eq(replayed->state.tetrominoY, recorded->state.tetrominoY);
+  ck_assert_uint_eq(replayed->state.randomState, recorded->state.randomState);
+  ck_assert_mem_eq(replayed->state.board, recorded->state.board,
+                   sizeof(recorded->state.board));
+
+  // Truncated logs and foreign files are rejected
+  TetrisGame* broken = tetris_create();
+  ck_assert_int_ne(tetris_replay(broken, data, size / 2, &result), 0);
+  TetrisGame* foreign = tetris_create();
+  data[0] = 'X';
+  ck_assert_int_ne(tetris_replay(foreign, data, size, &result), 0);
+
+  free(data);
+  tetris_destroy(recorded);
+  tetris_destroy(replayed);
+  tetris_destroy(broken);
+  tetris_destroy(foreign);
+}
+END_TEST
+
+/**
+ * Checks that two game states describe the same position.
+ */
+static void assertSameState(const GameState* a, const GameState* b) {
+  ck_assert_int_eq(a->state, b->state);
+  ck_assert_int_eq(a->tetrominoType, b->tetrominoType);
+  ck_assert_int_eq(a->tetrominoX, b->tetrominoX);
+  ck_assert_int_eq(a->tetrominoY, b->tetrominoY);
+  ck_assert_int_eq(a->nextTetrominoType, b->nextTetrominoType);
+  ck_assert_int_eq(a->stats.score, b->stats.score);
+  ck_assert_int_eq(a->linesCleared, b->linesCleared);
+  ck_assert_uint_eq(a->randomState, b->randomState);
+  ck_assert_mem_eq(a->board, b->board, sizeof(a->board));
+}
+
+/**
+ * Tests that seeking in a replay restores the state at the given tick.
+ */
+START_TEST(testReplaySeek) {
+  TetrisGame* recorded = tetris_create();
+  tetris_seed(recorded, 31);
+  ck_assert_int_eq(tetris_startRecording(recorded), 0);
+  recorded->recorder->keyframeInterval = 16;
+  tetris_userInput(recorded, kActionStart, false);
+  TetrisSnapshot early, late;
+  playRandomGame(recorded, 31, 40);
+  tetris_save(recorded, &early);
+  playRandomGame(recorded, 32, 60);
+  tetris_save(recorded, &late);
+  playRandomGame(recorded, 33, 20000);
+  uint64_t total = recorded->recorder->ticks;
+  ck_assert_uint_ge(recorded->recorder->keyframeCount, 6);
+  size_t keyframe = recorded->recorder->keyframes[1].offset;
+  uint8_t* data = NULL;
+  size_t size = 0;
+  ck_assert_int_eq(tetris_finishRecording(recorded, &data, &size), 0);
+
+  TetrisGame* viewer = tetris_create();
+  uint64_t reached;
+  ck_assert_int_eq(tetris_seekReplay(viewer, data, size, 40, &reached), 0);
+  ck_assert_uint_eq(reached, 40);
+  assertSameState(&viewer->state, &early.state);
+  ck_assert_int_eq(tetris_seekReplay(viewer, data, size, 100, &reached), 0);
+  ck_assert_uint_eq(reached, 100);
+  assertSameState(&viewer->state, &late.state);
+  ck_assert(!viewer->state.persistHighScore);
+  // Назад и за конец записи
+  ck_assert_int_eq(tetris_seekReplay(viewer, data, size, 0, &reached), 0);
+  ck_assert_int_eq(viewer->state.state, kStart);
+  ck_assert_int_eq(tetris_seekReplay(viewer, data, size, UINT64_MAX, &reached),
+                   0);
+  ck_assert_uint_eq(reached, total);
+  assertSameState(&viewer->state, &recorded->state);
+  ck_assert_int_ne(tetris_seekReplay(viewer, data, size / 2, total, NULL), 0);
+  // Ключевой кадр с полями вне допустимых значений отвергается.
+  const size_t kCorrupt[] = {0, 1, 2, 3, kReplayKeyframeSize - 1};
+  for (size_t i = 0; i < sizeof(kCorrupt) / sizeof(kCorrupt[0]); ++i) {
+    uint8_t saved = data[keyframe + kCorrupt[i]];
+    data[keyframe + kCorrupt[i]] = 0xFE;
+    ck_assert_int_ne(tetris_seekReplay(viewer, data, size, 40, NULL), 0);
+    data[keyframe + kCorrupt[i]] = saved;
+  }
+  ck_assert_int_eq(tetris_seekReplay(viewer, data, size, 40, NULL), 0);
+  assertSameState(&viewer->state, &early.state);
 
-  freeMatrix(info->field, kRow);
-  freeMatrix(info->next, kFigureSize);
+  free(data);
+  tetris_destroy(recorded);
+  tetris_destroy(viewer);
+}
+END_TEST
+
+/**
+ * Appends an unsigned LEB128 varint to a hand-built replay log.
+ */
+static size_t putVarint(uint8_t* data, size_t size, uint64_t value) {
+  while (value >= 0x80) {
+    data[size++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  data[size++] = (uint8_t)value;
+  return size;
+}
+
+/**
+ * Tests that huge tick counts are not simulated once ticks stop changing
+ * the game, and that input after the game is over is rejected.
+ */
+START_TEST(testReplayIdleTicks) {
+  TetrisGame* recorded = tetris_create();
+  tetris_seed(recorded, 5);
+  ck_assert_int_eq(tetris_startRecording(recorded), 0);
+  uint8_t header[kReplayHeaderSize];
+  memcpy(header, recorded->recorder->data, sizeof(header));
+  tetris_destroy(recorded);
+  const uint64_t kHuge = 1ULL << 58;
+  // Без ввода игра заканчивается сама; пауза длится весь остаток.
+  const UserAction kLast[] = {kActionUp, kActionPause};
+  for (int i = 0; i < 2; ++i) {
+    uint8_t data[64];
+    memcpy(data, header, sizeof(header));
+    size_t size = putVarint(data, sizeof(header), kActionStart);
+    if (kLast[i] != kActionUp) {
+      size = putVarint(data, size, kLast[i]);
+    }
+    size = putVarint(data, size, kHuge << kReplayFlagBits | kReplayControl);
+    size = putVarint(data, size, kReplayEnd);
+    size = putVarint(data, size, 0);
+    size = putVarint(data, size, 0);
+    TetrisGame* replayed = tetris_create();
+    ReplayResult result;
+    ck_assert_int_eq(tetris_replay(replayed, data, size, &result), 0);
+    ck_assert_uint_eq(result.ticks, kHuge);
+    tetris_destroy(replayed);
+  }
+  // Ввод после конца игры
+  uint8_t data[64];
+  memcpy(data, header, sizeof(header));
+  size_t size = putVarint(data, sizeof(header), kActionStart);
+  size = putVarint(data, size, kActionTerminate);
+  size = putVarint(data, size, kActionLeft);
+  size = putVarint(data, size, kReplayControl);
+  size = putVarint(data, size, kReplayEnd);
+  size = putVarint(data, size, 0);
+  size = putVarint(data, size, 0);
+  TetrisGame* replayed = tetris_create();
+  ReplayResult result;
+  ck_assert_int_ne(tetris_replay(replayed, data, size, &result), 0);
+  tetris_destroy(replayed);
+  // Такой ввод и не записывается.
+  recorded = tetris_create();
+  ck_assert_int_eq(tetris_startRecording(recorded), 0);
+  tetris_userInput(recorded, kActionStart, false);
+  tetris_userInput(recorded, kActionTerminate, false);
+  size_t before = recorded->recorder->size;
+  tetris_userInput(recorded, kActionLeft, false);
+  tetris_userInputBatch(recorded, kLast, NULL, 2);
+  ck_assert_uint_eq(recorded->recorder->size, before);
+  tetris_destroy(recorded);
+}
+END_TEST
+
+/**
+ * Tests that a restored snapshot continues exactly like the saved game.
+ */
+START_TEST(testSnapshotRestore) {
+  TetrisGame* game = tetris_create();
+  tetris_seed(game, 21);
+  tetris_userInput(game, kActionStart, false);
+  for (int i = 0; i < 12; ++i) {
+    tetris_userInput(game, i % 3 ? kActionLeft : kActionDown, false);
+    tetris_tick(game);
+  }
+  ck_assert_int_ne(game->state.state, kGameOver);
+  TetrisSnapshot snapshot;
+  tetris_save(game, &snapshot);
+  playRandomGame(game, 5, 20000);
+  ck_assert_int_eq(game->state.state, kGameOver);
+
+  // Снимок загружается и в другой экземпляр, и обратно в исходный.
+  TetrisGame* branch = tetris_create();
+  tetris_restore(branch, &snapshot);
+  playRandomGame(branch, 5, 20000);
+  tetris_restore(game, &snapshot);
+  ck_assert_int_ne(game->state.state, kGameOver);
+  playRandomGame(game, 5, 20000);
+  ck_assert_int_eq(branch->state.stats.score, game->state.stats.score);
+  ck_assert_int_eq(branch->state.linesCleared, game->state.linesCleared);
+  ck_assert_uint_eq(branch->state.randomState, game->state.randomState);
+  ck_assert_mem_eq(branch->state.board, game->state.board,
+                   sizeof(game->state.board));
+  tetris_destroy(game);
+  tetris_destroy(branch);
+}
+END_TEST
+
+/**
+ * Tests that a restored snapshot does not change whether the instance
+ * touches the high score file.
+ */
+START_TEST(testRestoreKeepsHighScoreSetting) {
+  TetrisSnapshot original, snapshot;
+  tetris_save(getDefaultGame(), &original);
+  ck_assert(original.state.persistHighScore);
+  TetrisGame* game = tetris_create();
+  tetris_restore(game, &original);
+  ck_assert(!game->state.persistHighScore);
+  tetris_save(game, &snapshot);
+  tetris_restore(getDefaultGame(), &snapshot);
+  ck_assert(getGameState()->persistHighScore);
+  tetris_restore(getDefaultGame(), &original);
+  tetris_destroy(game);
+}
+END_TEST
+
+/**
+ * Tests placement counts on an empty board and a placement reachable only
+ * by sliding under an overhang.
+ */
+START_TEST(testPlacements) {
+  static const int kExpected[] = {17, 34, 9, 34, 17, 17, 34};  // ILOTSZJ
+  GameState* gs = initGameState();
+  Placement placements[kMaxPlacements];
+  for (int type = 0; type < 7; ++type) {
+    const PieceMask* spawn = &kPieceMasks[type][0];
+    ck_assert_int_eq(enumeratePlacements(gs, type, 0, spawn->spawnX,
+                                         spawn->spawnY, placements),
+                     kExpected[type]);
+  }
+
+  // Полка над левыми столбцами: горизонтальная I попадает под неё только
+  // сдвигом после падения.
+  gs->board[kRow - 2] = 0x00F;
+  rebuildColumnHeights(gs);
+  int count = enumeratePlacements(gs, 0, 0, kPieceMasks[0][0].spawnX, 0, placements);
+  bool tucked = false;
+  for (int i = 0; i < count; ++i) {
+    ck_assert(fits(gs, 0, placements[i].rotation, placements[i].x,
+                   placements[i].y));
+    ck_assert(!fits(gs, 0, placements[i].rotation, placements[i].x,
+                    placements[i].y + 1));
+    tucked |= placements[i].rotation == 0 && placements[i].x == 0 &&
+              placements[i].y == kRow - 2;
+  }
+  ck_assert(tucked);
+  ck_assert_int_eq(enumeratePlacements(gs, 0, 0, 0, kRow - 3, placements), 0);
+}
+END_TEST
+
+/**
+ * Tests perft counts of short piece sequences.
+ */
+START_TEST(testPerft) {
+  GameState* gs = initGameState();
+  const int pieces[] = {0, 0, 2};  // I, I, O
+  ck_assert_uint_eq(perft(gs, pieces, 0), 1);
+  ck_assert_uint_eq(perft(gs, pieces, 1), 17);
+  ck_assert_uint_eq(perft(gs, pieces, 2), 17 * 17);
+
+  TetrisGame* game = tetris_create();
+  tetris_userInput(game, kActionStart, false);
+  tetris_tick(game);  // kSpawn -> kFalling
+  Placement placements[kMaxPlacements];
+  int type = game->state.tetrominoType;
+  ck_assert_int_eq(tetris_placements(game, placements),
+                   (int)perft(&game->state, &type, 1));
+  applyPlacement(&game->state, type, &placements[0]);
+  ck_assert(!game->state.pieceActive);
+  ck_assert_int_eq(tetris_placements(game, placements), 0);
+  tetris_destroy(game);
+}
+END_TEST
+
+/**
+ * Tests the board features of an empty board and a small stack.
+ */
+START_TEST(testExtractFeatures) {
+  GameState* gs = initGameState();
+  BoardFeatures features;
+  extractFeatures(gs->board, &features);
+  ck_assert_int_eq(features.aggregateHeight, 0);
+  ck_assert_int_eq(features.holes, 0);
+  ck_assert_int_eq(features.rowTransitions, 2 * kRow);
+  ck_assert_int_eq(features.columnTransitions, kCol);
+
+  // Дыры в столбцах 0 и 2, колодец глубины 1 в столбце 1.
+  gs->board[kRow - 3] = 0x001;
+  gs->board[kRow - 2] = 0x004;
+  gs->board[kRow - 1] = 0x3FB;
+  extractFeatures(gs->board, &features);
+  static const uint8_t kHeights[kCol] = {3, 1, 2, 1, 1, 1, 1, 1, 1, 1};
+  ck_assert_mem_eq(features.heights, kHeights, sizeof(kHeights));
+  ck_assert_int_eq(features.maxHeight, 3);
+  ck_assert_int_eq(features.aggregateHeight, 13);
+  ck_assert_int_eq(features.holes, 2);
+  ck_assert_int_eq(features.coveredCells, 2);
+  ck_assert_int_eq(features.bumpiness, 4);
+  ck_assert_int_eq(features.rowTransitions, 2 * kRow + 2);
+  ck_assert_int_eq(features.columnTransitions, 14);
+  ck_assert_int_eq(features.wellDepths[1], 1);
+  ck_assert_int_eq(features.cumulativeWells, 1);
+}
+END_TEST
+
+START_TEST(testAutoplay) {
+  TetrisGame* game = tetris_create();
+  ck_assert_ptr_nonnull(game);
+  tetris_seed(game, 7);
+  tetris_userInput(game, kActionStart, false);
+  Autoplay bot = {.weights = &kDefaultEvalWeights};
+  for (int tick = 0; tick < 20000 && game->state.linesCleared < 200; ++tick) {
+    while (autoplayStep(&bot, game)) {
+    }
+    tetris_tick(game);
+  }
+  ck_assert_int_ne(game->state.state, kGameOver);
+  ck_assert_int_ge(game->state.linesCleared, 200);
+  tetris_destroy(game);
+}
+END_TEST
+
+START_TEST(testBeamPlanner) {
+  PlannerConfig config = kDefaultPlannerConfig;
+  config.beamWidth = 32;
+  config.preview = 1;
+  config.budgetMs = 10000;
+  BeamPlanner* single = plannerCreate(&config);
+  config.threads = 3;
+  BeamPlanner* parallel = plannerCreate(&config);
+  ck_assert_ptr_nonnull(single);
+  ck_assert_ptr_nonnull(parallel);
+
+  TetrisGame* game = tetris_create();
+  tetris_seed(game, 11);
+  tetris_userInput(game, kActionStart, false);
+  Autoplay bot = {.weights = &kDefaultEvalWeights, .planner = parallel};
+  for (int tick = 0; tick < 20000 && game->state.linesCleared < 50; ++tick) {
+    // Результат не зависит от числа потоков.
+    if (game->state.pieceActive && !bot.planned) {
+      AutoplayPlan expected;
+      AutoplayPlan actual;
+      PlannerStats stats;
+      ck_assert(plannerChoose(single, &game->state, &expected, NULL));
+      ck_assert(plannerChoose(parallel, &game->state, &actual, &stats));
+      ck_assert_int_eq(actual.rotations, expected.rotations);
+      ck_assert_int_eq(actual.shift, expected.shift);
+      ck_assert_int_eq(stats.depth, 3);
+      ck_assert(!stats.timedOut);
+    }
+    while (autoplayStep(&bot, game)) {
+    }
+    tetris_tick(game);
+  }
+  ck_assert_int_ne(game->state.state, kGameOver);
+  ck_assert_int_ge(game->state.linesCleared, 50);
+  tetris_destroy(game);
+  plannerDestroy(single);
+  plannerDestroy(parallel);
+}
+END_TEST
+
+START_TEST(testZobristHash) {
+  TetrisGame* game = tetris_create();
+  tetris_seed(game, 5);
+  tetris_userInput(game, kActionStart, false);
+  GameState* gs = &game->state;
+  ck_assert_uint_eq(gs->boardHash, 0);
+  Autoplay bot = {.weights = &kDefaultEvalWeights};
+  for (int tick = 0; tick < 5000; ++tick) {
+    while (autoplayStep(&bot, game)) {
+    }
+    tetris_tick(game);
+    ck_assert_uint_eq(gs->boardHash, hashBoard(gs->board));
+  }
+  ck_assert_int_gt(gs->linesCleared, 0);
+
+  // Хеш позиции учитывает падающую фигуру.
+  while (!gs->pieceActive) {
+    tetris_tick(game);
+  }
+  uint64_t before = positionHash(gs);
+  ck_assert_uint_ne(before, gs->boardHash);
+  gs->tetrominoX++;
+  ck_assert_uint_ne(positionHash(gs), before);
+  gs->tetrominoX--;
+  ck_assert_uint_eq(positionHash(gs), before);
+  tetris_destroy(game);
+}
+END_TEST
+
+START_TEST(testTranspositionTable) {
+  TranspositionTable table;
+  ck_assert_int_ne(ttCreate(&table, 0), 0);
+  ck_assert_int_eq(ttCreate(&table, 4), 0);
+  uint64_t value;
+  ck_assert(!ttProbe(&table, 0, &value));
+  ck_assert(!ttProbe(&table, 42, &value));
+  ttStore(&table, 42, 7);
+  ck_assert(ttProbe(&table, 42, &value));
+  ck_assert_uint_eq(value, 7);
+  // Ключ с тем же слотом вытесняет прежний.
+  ttStore(&table, 42 + 16, 9);
+  ck_assert(!ttProbe(&table, 42, &value));
+  ck_assert(ttProbe(&table, 42 + 16, &value));
+  ck_assert_uint_eq(value, 9);
+  ttClear(&table);
+  ck_assert(!ttProbe(&table, 42 + 16, &value));
+  ttDestroy(&table);
+}
+END_TEST
+
+/**
+ * Compares a batch lane with the TetrisGame it mirrors.
+ * @param batch The batch.
+ * @param lane Lane of the game.
+ * @param game The game instance.
+ */
+static void assertLaneMatches(const TetrisBatch* batch, int lane,
+                              const TetrisGame* game) {
+  GameState lanes;
+  tetris_batchGame(batch, lane, &lanes);
+  const GameState* gs = &game->state;
+  ck_assert_int_eq(lanes.state, gs->state);
+  ck_assert_int_eq(lanes.pieceActive, gs->pieceActive);
+  ck_assert_int_eq(lanes.nextTetrominoType, gs->nextTetrominoType);
+  ck_assert_int_eq(memcmp(lanes.board, gs->board, sizeof(gs->board)), 0);
+  ck_assert_int_eq(memcmp(lanes.columnHeights, gs->columnHeights,
+                          sizeof(gs->columnHeights)),
+                   0);
+  ck_assert_uint_eq(lanes.boardHash, gs->boardHash);
+  if (gs->pieceActive) {
+    ck_assert_int_eq(lanes.tetrominoType, gs->tetrominoType);
+    ck_assert_int_eq(lanes.rotationIndex, gs->rotationIndex);
+    ck_assert_int_eq(lanes.tetrominoX, gs->tetrominoX);
+    ck_assert_int_eq(lanes.tetrominoY, gs->tetrominoY);
+  }
+  if (gs->state == kFalling) {
+    ck_assert_int_eq(lanes.ghostY, gs->ghostY);
+  }
+  ck_assert_int_eq(lanes.stats.score, gs->stats.score);
+  ck_assert_int_eq(lanes.stats.level, gs->stats.level);
+  ck_assert_int_eq(lanes.stats.speed, gs->stats.speed);
+  ck_assert_int_eq(lanes.stats.pause, gs->stats.pause);
+  ck_assert_int_eq(lanes.pointsTowardLevel, gs->pointsTowardLevel);
+  ck_assert_int_eq(lanes.linesCleared, gs->linesCleared);
+  ck_assert_uint_eq(lanes.randomState, gs->randomState);
+  ck_assert_int_eq(lanes.bagLeft, gs->bagLeft);
+}
+
+START_TEST(testBatchMatchesGames) {
+  enum { kGames = 20, kSteps = 2000 };
+  ck_assert_ptr_null(tetris_batchCreate(0, kRandomizerBag));
+  TetrisBatch* batch = tetris_batchCreate(kGames, kRandomizerBag);
+  ck_assert_ptr_nonnull(batch);
+  ck_assert_int_eq(batch->lanes, 32);
+  TetrisGame* games[kGames];
+  AutoplayPlan plans[kGames];
+  bool planned[kGames] = {false};
+  for (int g = 0; g < kGames; ++g) {
+    games[g] = tetris_create();
+    games[g]->state.persistHighScore = false;
+    tetris_seed(games[g], 100 + g);
+    tetris_setRandomizer(games[g], kRandomizerBag);
+    tetris_userInput(games[g], kActionStart, false);
+    tetris_batchReset(batch, g, 100 + g);
+  }
+  // Бот с шумом: игры доходят до очистки линий, но делают и лишние ходы.
+  uint64_t rng = 5;
+  for (int step = 0; step < kSteps; ++step) {
+    UserAction actions[kGames];
+    for (int g = 0; g < kGames; ++g) {
+      const GameState* gs = &games[g]->state;
+      if (gs->state != kFalling) {
+        planned[g] = false;
+      } else if (!planned[g]) {
+        planned[g] = autoplayChoose(gs, &kDefaultEvalWeights, &plans[g]);
+      }
+      AutoplayPlan* plan = &plans[g];
+      actions[g] = kActionUp;
+      if (randomNext(&rng) % 8 == 0) {
+        static const UserAction kNoise[] = {kActionLeft, kActionRight,
+                                            kActionRotate, kActionDown};
+        actions[g] = kNoise[randomNext(&rng) % 4];
+      } else if (planned[g] && plan->rotations > 0) {
+        actions[g] = kActionRotate;
+        plan->rotations--;
+      } else if (planned[g] && plan->shift != 0) {
+        actions[g] = plan->shift < 0 ? kActionLeft : kActionRight;
+        plan->shift += plan->shift < 0 ? 1 : -1;
+      } else if (planned[g]) {
+        actions[g] = kActionDown;
+      }
+      tetris_userInput(games[g], actions[g], false);
+      tetris_tick(games[g]);
+    }
+    int running = tetris_batchStep(batch, actions);
+    int expected = 0;
+    for (int g = 0; g < kGames; ++g) {
+      assertLaneMatches(batch, g, games[g]);
+      expected += games[g]->state.state != kGameOver;
+    }
+    ck_assert_int_eq(running, expected);
+  }
+  int lines = 0;
+  for (int g = 0; g < kGames; ++g) {
+    lines += games[g]->state.linesCleared;
+    tetris_destroy(games[g]);
+  }
+  ck_assert_int_gt(lines, 0);
+  // Без ввода игры только падают и фиксируются.
+  tetris_batchReset(batch, 0, 7);
+  TetrisGame* idle = tetris_create();
+  idle->state.persistHighScore = false;
+  tetris_seed(idle, 7);
+  tetris_setRandomizer(idle, kRandomizerBag);
+  tetris_userInput(idle, kActionStart, false);
+  for (int step = 0; step < 1000; ++step) {
+    tetris_batchStep(batch, NULL);
+    tetris_tick(idle);
+    assertLaneMatches(batch, 0, idle);
+  }
+  ck_assert_int_eq(idle->state.state, kGameOver);
+  tetris_destroy(idle);
+  tetris_batchDestroy(batch);
+}
+END_TEST
+
+START_TEST(testShmRing) {
+  char name[64];
+  snprintf(name, sizeof(name), "/tetris_test_%d", (int)getpid());
+  ck_assert_ptr_null(tetris_shmCreate(name, 3, 2));
+  TetrisShmRing* engine = tetris_shmCreate(name, 4, 2);
+  ck_assert_ptr_nonnull(engine);
+  TetrisShmRing* trainer = tetris_shmOpen(name);
+  ck_assert_ptr_nonnull(trainer);
+  ck_assert_ptr_ne(trainer->header, engine->header);
+  TetrisGame* game = tetris_create();
+  game->state.persistHighScore = false;
+  tetris_seed(game, 3);
+  tetris_userInput(game, kActionStart, false);
+  GameState published[4];
+  for (int i = 0; i < 4; ++i) {
+    tetris_tick(game);
+    published[i] = game->state;
+    ck_assert(tetris_shmPublish(engine, &game->state));
+  }
+  // Тренер ещё ничего не прочитал: пятый кадр отбрасывается.
+  ck_assert(!tetris_shmPublish(engine, &game->state));
+  for (int i = 0; i < 4; ++i) {
+    const TetrisObservation* frame = tetris_shmPeekFrame(trainer);
+    ck_assert_ptr_nonnull(frame);
+    const GameState* gs = &published[i];
+    ck_assert_int_eq(frame->seq, i + 1);
+    ck_assert_int_eq(frame->state, gs->state);
+    ck_assert_int_eq(frame->nextType, gs->nextTetrominoType);
+    ck_assert_int_eq(frame->score, gs->stats.score);
+    ck_assert_int_eq(frame->lines, gs->linesCleared);
+    ck_assert_mem_eq(frame->field, gs->board, sizeof(frame->field));
+    uint16_t expected[kRow];
+    uint16_t rows[kRow];
+    memcpy(expected, gs->board, sizeof(expected));
+    memcpy(rows, frame->field, sizeof(rows));
+    overlayTetromino(gs, expected);
+    ck_assert_int_eq(frame->pieceType,
+                     gs->pieceActive ? gs->tetrominoType : kNoTetromino);
+    for (int r = 0; r < kFigureSize && frame->pieceType != kNoTetromino;
+         ++r) {
+      int y = frame->y + r;
+      unsigned row = frame->x >= 0 ? (unsigned)frame->piece[r] << frame->x
+                                   : (unsigned)frame->piece[r] >> -frame->x;
+      if (y >= 0 && y < kRow) {
+        rows[y] |= (uint16_t)row;
+      }
+    }
+    ck_assert_mem_eq(rows, expected, sizeof(rows));
+    tetris_shmReleaseFrame(trainer);
+  }
+  ck_assert_ptr_null(tetris_shmPeekFrame(trainer));
+  ck_assert(tetris_shmPublish(engine, &game->state));
+  ck_assert_int_eq(tetris_shmPeekFrame(trainer)->seq, 6);
+  // Действия идут обратно; чужие коды пропускаются.
+  UserAction action;
+  ck_assert(!tetris_shmPopAction(engine, &action));
+  ck_assert(tetris_shmPushAction(trainer, kActionLeft));
+  ck_assert(tetris_shmPushAction(trainer, (UserAction)42));
+  ck_assert(!tetris_shmPushAction(trainer, kActionRotate));
+  ck_assert(tetris_shmPopAction(engine, &action));
+  ck_assert_int_eq(action, kActionLeft);
+  ck_assert(!tetris_shmPopAction(engine, &action));
+  ck_assert(tetris_shmPushAction(trainer, kActionRotate));
+  ck_assert(tetris_shmPopAction(engine, &action));
+  ck_assert_int_eq(action, kActionRotate);
+  // Размеры из заголовка, переписанного тренером, движок не использует.
+  trainer->header->frameSlots = 1u << 20;
+  trainer->header->actionSlots = 1u << 20;
+  ck_assert_int_eq(engine->frameSlots, 4);
+  ck_assert_int_eq(engine->actionSlots, 2);
+  for (int i = 0; i < 8; ++i) {
+    tetris_shmPublish(engine, &game->state);
+  }
+  ck_assert(tetris_shmPushAction(trainer, kActionDown));
+  ck_assert(tetris_shmPushAction(trainer, kActionLeft));
+  ck_assert(!tetris_shmPushAction(trainer, kActionRight));
+  ck_assert(tetris_shmPopAction(engine, &action));
+  ck_assert_int_eq(action, kActionDown);
+  tetris_destroy(game);
+  tetris_shmClose(trainer);
+  tetris_shmClose(engine);
+  ck_assert_ptr_null(tetris_shmOpen(name));
 }
 END_TEST
 
@@ -768,6 +1787,37 @@ Suite* tetrisSuite(void) {
   tcase_add_test(tc_core, testRenderFieldPaused);
   tcase_add_test(tc_core, testRenderFieldGameOver);
   tcase_add_test(tc_core, testRenderFieldNonEmpty);
+  tcase_add_test(tc_core, testRenderFieldDirtyRegions);
+  tcase_add_test(tc_core, testPublishFrame);
+  tcase_add_test(tc_core, testColumnHeights);
+  tcase_add_test(tc_core, testLandingRow);
+  tcase_add_test(tc_core, testGhostPiece);
+  tcase_add_test(tc_core, testSeedRepeatsPieces);
+  tcase_add_test(tc_core, testSevenBag);
+  tcase_add_test(tc_core, testReplayRoundTrip);
+  tcase_add_test(tc_core, testReplaySeek);
+  tcase_add_test(tc_core, testReplayIdleTicks);
+  tcase_add_test(tc_core, testSnapshotRestore);
+  tcase_add_test(tc_core, testRestoreKeepsHighScoreSetting);
+  tcase_add_test(tc_core, testPlacements);
+  tcase_add_test(tc_core, testPerft);
+  tcase_add_test(tc_core, testExtractFeatures);
+  tcase_add_test(tc_core, testAutoplay);
+  tcase_add_test(tc_core, testBeamPlanner);
+  tcase_add_test(tc_core, testZobristHash);
+  tcase_add_test(tc_core, testTranspositionTable);
+  tcase_add_test(tc_core, testBatchMatchesGames);
+  tcase_add_test(tc_core, testShmRing);
+  tcase_add_test(tc_core, testSyncFieldView);
+  tcase_add_test(tc_core, testClearingShiftsRows);
+  tcase_add_test(tc_core, testPieceMasksMatchShapes);
+  tcase_add_test(tc_core, testFits);
+  tcase_add_test(tc_core, testClearingTetris);
+  tcase_add_test(tc_core, testMultipleInstances);
+  tcase_add_test(tc_core, testSeededInstancesRepeat);
+  tcase_add_test(tc_core, testInstanceSkipsHighScoreFile);
+  tcase_add_test(tc_core, testUserInputBatch);
+  tcase_add_test(tc_core, testApplyPendingShift);
   suite_add_tcase(s, tc_core);
   return s;
 }
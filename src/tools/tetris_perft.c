@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "placement.h"
+#include "tetris.h"
+
+// Deepest supported placement tree.
+enum { kMaxPerftDepth = 8 };
+
+static const char kTypeNames[] = "ILOTSZJ";
+
+static double elapsedSeconds(const struct timespec* start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)(now.tv_sec - start->tv_sec) +
+         (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void printUsage(const char* program) {
+  fprintf(stderr, "Usage: %s [-d depth] [-s seed] [-r uniform|bag]\n",
+          program);
+}
+
+/**
+ * Entry point of the placement benchmark. Deals a piece sequence from a
+ * seeded game and counts the placement tree on an empty board for every
+ * depth up to the requested one.
+ * @return 0 on success, non-zero on error.
+ */
+int main(int argc, char* argv[]) {
+  int depth = 3;
+  uint64_t seed = 1;
+  PieceRandomizer randomizer = kRandomizerUniform;
+  int opt;
+  while ((opt = getopt(argc, argv, "d:s:r:")) != -1) {
+    switch (opt) {
+      case 'd':
+        depth = atoi(optarg);
+        break;
+      case 's':
+        seed = strtoull(optarg, NULL, 10);
+        break;
+      case 'r':
+        if (strcmp(optarg, "bag") == 0) {
+          randomizer = kRandomizerBag;
+        } else if (strcmp(optarg, "uniform") == 0) {
+          randomizer = kRandomizerUniform;
+        } else {
+          printUsage(argv[0]);
+          return 1;
+        }
+        break;
+      default:
+        printUsage(argv[0]);
+        return 1;
+    }
+  }
+  if (optind != argc || depth < 1 || depth > kMaxPerftDepth) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  TetrisGame* game = tetris_create();
+  if (!game) {
+    return 1;
+  }
+  tetris_seed(game, seed);
+  tetris_setRandomizer(game, randomizer);
+  startGame(&game->state);
+  int pieces[kMaxPerftDepth];
+  char sequence[kMaxPerftDepth + 1] = {0};
+  for (int i = 0; i < depth; ++i) {
+    int rotation;
+    generateNextTetromino(&game->state, &pieces[i], &rotation);
+    sequence[i] = kTypeNames[pieces[i]];
+  }
+  printf("perft seed %llu, pieces %s\n", (unsigned long long)seed, sequence);
+
+  for (int d = 1; d <= depth; ++d) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    uint64_t leaves = perft(&game->state, pieces, d);
+    double seconds = elapsedSeconds(&start);
+    printf("depth %d  %14llu  %8.3f s  %12.0f leaves/s\n", d,
+           (unsigned long long)leaves, seconds,
+           seconds > 0 ? leaves / seconds : 0.0);
+  }
+  tetris_destroy(game);
+  return 0;
+}
@@ -0,0 +1,226 @@
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "replay.h"
+#include "tetris.h"
+#include "work_pool.h"
+
+// Extension of replay logs picked up from the directory.
+static const char kReplayExtension[] = ".ttr";
+
+// Verdict on one replay log.
+typedef enum {
+  kVerifyOk,         // Replay reproduces the stored score and lines.
+  kVerifyMismatch,   // Replay ends with a different score or line count.
+  kVerifyMalformed,  // The log could not be decoded.
+  kVerifyIoError     // The file could not be opened or mapped.
+} VerifyStatus;
+
+// Outcome of one file.
+typedef struct {
+  VerifyStatus status;  // Verdict.
+  ReplayResult replay;  // Replay outcome (valid unless malformed or I/O).
+} VerifyResult;
+
+// Context shared by the verification jobs.
+typedef struct {
+  const char* dir;        // Directory holding the logs.
+  char** names;           // File names, sorted.
+  VerifyResult* results;  // One slot per file.
+} VerifyRun;
+
+static bool hasReplayExtension(const char* name) {
+  size_t length = strlen(name);
+  size_t extension = sizeof(kReplayExtension) - 1;
+  return length > extension &&
+         strcmp(name + length - extension, kReplayExtension) == 0;
+}
+
+static int compareNames(const void* a, const void* b) {
+  return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+/**
+ * Lists the replay logs of a directory in name order.
+ * @param dir The directory.
+ * @param count Pointer to receive the number of files.
+ * @return Array of names (free each and the array), or NULL on error.
+ */
+static char** listReplays(const char* dir, int* count) {
+  DIR* handle = opendir(dir);
+  if (!handle) {
+    fprintf(stderr, "Failed to open directory %s\n", dir);
+    return NULL;
+  }
+  int capacity = 64;
+  char** names = malloc(capacity * sizeof(char*));
+  *count = 0;
+  struct dirent* entry;
+  while (names && (entry = readdir(handle))) {
+    if (!hasReplayExtension(entry->d_name)) {
+      continue;
+    }
+    if (*count == capacity) {
+      capacity *= 2;
+      char** grown = realloc(names, capacity * sizeof(char*));
+      if (!grown) {
+        for (int i = 0; i < *count; ++i) {
+          free(names[i]);
+        }
+        free(names);
+        names = NULL;
+        break;
+      }
+      names = grown;
+    }
+    names[*count] = strdup(entry->d_name);
+    if (names[*count]) {
+      ++*count;
+    }
+  }
+  closedir(handle);
+  if (!names) {
+    fprintf(stderr, "Failed to allocate file list\n");
+    return NULL;
+  }
+  qsort(names, *count, sizeof(char*), compareNames);
+  return names;
+}
+
+static void verifyFile(int index, void* context) {
+  VerifyRun* run = context;
+  VerifyResult* result = &run->results[index];
+  result->status = kVerifyIoError;
+  char path[4096];
+  snprintf(path, sizeof(path), "%s/%s", run->dir, run->names[index]);
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size == 0) {
+    close(fd);
+    result->status = kVerifyMalformed;
+    return;
+  }
+  size_t size = (size_t)info.st_size;
+  void* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    return;
+  }
+  TetrisGame* game = tetris_create();
+  if (game) {
+    if (tetris_replay(game, data, size, &result->replay) != 0) {
+      result->status = kVerifyMalformed;
+    } else if (result->replay.score != result->replay.expectedScore ||
+               result->replay.lines != result->replay.expectedLines) {
+      result->status = kVerifyMismatch;
+    } else {
+      result->status = kVerifyOk;
+    }
+    tetris_destroy(game);
+  }
+  munmap(data, size);
+}
+
+static double elapsedSeconds(const struct timespec* start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)(now.tv_sec - start->tv_sec) +
+         (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/**
+ * Prints failed files and a summary.
+ * @return Number of files that did not verify.
+ */
+static int printReport(const VerifyRun* run, int count, int threads,
+                       double seconds) {
+  static const char* kVerdicts[] = {"ok", "result mismatch", "malformed",
+                                    "unreadable"};
+  int failed = 0;
+  long long ticks = 0;
+  for (int i = 0; i < count; ++i) {
+    const VerifyResult* result = &run->results[i];
+    if (result->status == kVerifyOk) {
+      ticks += (long long)result->replay.ticks;
+      continue;
+    }
+    ++failed;
+    if (result->status == kVerifyMismatch) {
+      const ReplayResult* replay = &result->replay;
+      printf("%s: %s (score replayed %d, stored %d; lines replayed %d, "
+             "stored %d)\n",
+             run->names[i], kVerdicts[result->status], replay->score,
+             replay->expectedScore, replay->lines, replay->expectedLines);
+    } else {
+      printf("%s: %s\n", run->names[i], kVerdicts[result->status]);
+    }
+  }
+  printf("%d files, %d verified, %d failed, %d threads\n", count,
+         count - failed, failed, threads);
+  printf("time     %.3f s\n", seconds);
+  printf("files/s  %.1f\n", count / seconds);
+  printf("ticks/s  %.1f\n", ticks / seconds);
+  return failed;
+}
+
+static void printUsage(const char* program) {
+  fprintf(stderr, "Usage: %s [-j threads] replay_dir\n", program);
+}
+
+/**
+ * Entry point of the replay verifier. Re-simulates every .ttr log in a
+ * directory and checks the final score and lines against the stored ones.
+ * @return 0 if every log verifies, non-zero otherwise.
+ */
+int main(int argc, char* argv[]) {
+  int threads = defaultThreadCount();
+  int opt;
+  while ((opt = getopt(argc, argv, "j:")) != -1) {
+    if (opt == 'j') {
+      threads = atoi(optarg);
+    } else {
+      printUsage(argv[0]);
+      return 1;
+    }
+  }
+  if (optind != argc - 1 || threads <= 0) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  VerifyRun run = {.dir = argv[optind]};
+  int count;
+  run.names = listReplays(run.dir, &count);
+  if (!run.names) {
+    return 1;
+  }
+  run.results = calloc(count ? count : 1, sizeof(VerifyResult));
+  int status = 1;
+  if (!run.results) {
+    fprintf(stderr, "Failed to allocate results\n");
+  } else {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    status = parallelFor(count, threads, verifyFile, &run);
+    double seconds = elapsedSeconds(&start);
+    if (status == 0) {
+      status = printReport(&run, count, threads, seconds) != 0;
+    }
+  }
+  for (int i = 0; i < count; ++i) {
+    free(run.names[i]);
+  }
+  free(run.names);
+  free(run.results);
+  return status;
+}
@@ -0,0 +1,459 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "autoplay.h"
+#include "batch.h"
+#include "planner.h"
+#include "replay.h"
+#include "tetris.h"
+#include "work_pool.h"
+
+// Input policy: picks the action sent before a tick. Returns false to let
+// gravity run alone on this tick.
+typedef bool (*SimDecide)(const GameState* gs, uint64_t* rng,
+                          UserAction* action, bool* hold);
+
+// Named input policy selectable from the command line. Policies without a
+// decision function are played by the autoplay bot.
+typedef struct {
+  const char* name;  // Policy name for -p.
+  SimDecide decide;  // Decision function, NULL for the bot.
+  bool beam;         // The bot plans with the beam search planner.
+} SimPolicy;
+
+// Simulation settings shared by all games.
+typedef struct {
+  int games;                   // Number of games to play.
+  int threads;                 // Worker threads.
+  uint64_t seed;               // Seed of game 0; game i uses seed + i.
+  long maxTicks;               // Tick limit per game.
+  const SimPolicy* policy;     // Input policy.
+  PieceRandomizer randomizer;  // Piece randomizer.
+  const char* replayDir;       // Directory for replay logs, or NULL.
+  PlannerConfig planner;       // Planner settings of the beam policy.
+  int batchSize;               // Games per TetrisBatch, 0 for TetrisGame.
+} SimConfig;
+
+// Outcome of a single game.
+typedef struct {
+  int score;          // Final score.
+  int lines;          // Lines cleared.
+  long ticks;         // Ticks simulated.
+  long decisions;     // Targets chosen by the bot.
+  double decisionMs;  // Time spent choosing them.
+  double slowestMs;   // Longest single decision.
+  bool failed;        // The game or its replay log could not be made.
+} SimResult;
+
+// Context shared by the simulation jobs.
+typedef struct {
+  const SimConfig* config;  // Settings.
+  SimResult* results;       // One slot per game.
+} SimRun;
+
+static bool decideIdle(const GameState* gs, uint64_t* rng,
+                       UserAction* action, bool* hold) {
+  (void)gs;
+  (void)rng;
+  (void)action;
+  (void)hold;
+  return false;
+}
+
+static bool decideDrop(const GameState* gs, uint64_t* rng,
+                       UserAction* action, bool* hold) {
+  (void)rng;
+  *action = kActionDown;
+  *hold = false;
+  return gs->state == kFalling;
+}
+
+static bool decideRandom(const GameState* gs, uint64_t* rng,
+                         UserAction* action, bool* hold) {
+  static const UserAction kChoices[] = {kActionLeft, kActionRight,
+                                        kActionRotate, kActionLeft,
+                                        kActionRight, kActionRotate,
+                                        kActionDown};
+  if (gs->state != kFalling || randomNext(rng) % 2) {
+    return false;
+  }
+  *action =
+      kChoices[randomNext(rng) % (sizeof(kChoices) / sizeof(kChoices[0]))];
+  *hold = false;
+  return true;
+}
+
+static const SimPolicy kPolicies[] = {{"random", decideRandom, false},
+                                      {"drop", decideDrop, false},
+                                      {"idle", decideIdle, false},
+                                      {"greedy", NULL, false},
+                                      {"beam", NULL, true}};
+
+static const SimPolicy* findPolicy(const char* name) {
+  for (size_t i = 0; i < sizeof(kPolicies) / sizeof(kPolicies[0]); ++i) {
+    if (strcmp(kPolicies[i].name, name) == 0) {
+      return &kPolicies[i];
+    }
+  }
+  return NULL;
+}
+
+static double elapsedSeconds(const struct timespec* start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)(now.tv_sec - start->tv_sec) +
+         (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/**
+ * Lets the bot act before a tick and times the calls that choose a target.
+ * @param bot The bot.
+ * @param game The game instance.
+ * @param result The game's result, which collects the timings.
+ */
+static void runBot(Autoplay* bot, TetrisGame* game, SimResult* result) {
+  bool planned = bot->planned;
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  while (autoplayStep(bot, game)) {
+  }
+  if (!planned && bot->planned) {
+    double ms = elapsedSeconds(&start) * 1e3;
+    result->decisions++;
+    result->decisionMs += ms;
+    if (ms > result->slowestMs) {
+      result->slowestMs = ms;
+    }
+  }
+}
+
+static void simulateGame(int index, void* context) {
+  SimRun* run = context;
+  const SimConfig* config = run->config;
+  SimResult* result = &run->results[index];
+  TetrisGame* game = tetris_create();
+  if (!game) {
+    result->failed = true;
+    return;
+  }
+  Autoplay bot = {.weights = &kDefaultEvalWeights};
+  if (config->policy->beam) {
+    bot.planner = plannerCreate(&config->planner);
+    if (!bot.planner) {
+      result->failed = true;
+      tetris_destroy(game);
+      return;
+    }
+  }
+  GameState* gs = &game->state;
+  tetris_seed(game, config->seed + (uint64_t)index);
+  tetris_setRandomizer(game, config->randomizer);
+  char path[4096];
+  if (config->replayDir) {
+    snprintf(path, sizeof(path), "%s/game_%06d.ttr", config->replayDir, index);
+    if (tetris_startRecording(game) != 0) {
+      fprintf(stderr, "Failed to record replay %s\n", path);
+      result->failed = true;
+    }
+  }
+  uint64_t policySeed = ~(config->seed + (uint64_t)index);
+  tetris_userInput(game, kActionStart, false);
+
+  long ticks = 0;
+  while (gs->state != kGameOver && ticks < config->maxTicks) {
+    UserAction action;
+    bool hold;
+    if (!config->policy->decide) {
+      runBot(&bot, game, result);
+    } else if (config->policy->decide(gs, &policySeed, &action, &hold)) {
+      tetris_userInput(game, action, hold);
+    }
+    tetris_tick(game);
+    ++ticks;
+  }
+  result->score = gs->stats.score;
+  result->lines = gs->linesCleared;
+  result->ticks = ticks;
+  if (game->recorder && tetris_saveRecording(game, path) != 0) {
+    result->failed = true;
+  }
+  plannerDestroy(bot.planner);
+  tetris_destroy(game);
+}
+
+/**
+ * Returns the number of batches the games are split into: one per thread,
+ * but no more than it takes to give every lane a game.
+ * @param config Settings.
+ * @return Number of batches.
+ */
+static int batchCount(const SimConfig* config) {
+  int batches = (config->games + config->batchSize - 1) / config->batchSize;
+  return batches < config->threads ? batches : config->threads;
+}
+
+/**
+ * Plays a contiguous share of the games in one TetrisBatch of up to
+ * config->batchSize lanes. A lane whose game ends starts the next game of
+ * the share, so no lane idles while games are left. The policy sees a
+ * GameState with only the FSM state filled in, which is all that the
+ * random, drop and idle policies read. The games are the same as with
+ * simulateGame().
+ * @param index Index of the batch.
+ * @param context The simulation run.
+ */
+static void simulateBatch(int index, void* context) {
+  SimRun* run = context;
+  const SimConfig* config = run->config;
+  int batches = batchCount(config);
+  int first = (int)((long long)config->games * index / batches);
+  int last = (int)((long long)config->games * (index + 1) / batches);
+  int lanes = last - first < config->batchSize ? last - first
+                                               : config->batchSize;
+  TetrisBatch* batch = tetris_batchCreate(lanes, config->randomizer);
+  UserAction* actions = malloc(lanes * sizeof(UserAction));
+  uint64_t* policySeeds = malloc(lanes * sizeof(uint64_t));
+  int* games = malloc(lanes * sizeof(int));
+  long* ticks = malloc(lanes * sizeof(long));
+  if (!batch || !actions || !policySeeds || !games || !ticks) {
+    fprintf(stderr, "Failed to allocate batch %d\n", index);
+    for (int i = first; i < last; ++i) {
+      run->results[i].failed = true;
+    }
+  } else {
+    int next = first;
+    int busy = lanes;
+    for (int g = 0; g < lanes; ++g) {
+      games[g] = -1;
+      batch->state[g] = kGameOver;
+    }
+    GameState view = {0};
+    while (busy > 0) {
+      for (int g = 0; g < lanes; ++g) {
+        actions[g] = kActionUp;
+        if (batch->state[g] == kGameOver || ticks[g] >= config->maxTicks) {
+          // Игра дорожки закончилась: записать итог и начать следующую.
+          if (games[g] >= 0) {
+            SimResult* result = &run->results[games[g]];
+            result->score = batch->score[g];
+            result->lines = batch->lines[g];
+            result->ticks = ticks[g];
+            games[g] = -1;
+            batch->state[g] = kGameOver;
+            busy -= next >= last;
+          }
+          if (next >= last) {
+            continue;
+          }
+          uint64_t seed = config->seed + (uint64_t)next;
+          tetris_batchReset(batch, g, seed);
+          policySeeds[g] = ~seed;
+          ticks[g] = 0;
+          games[g] = next++;
+        }
+        ticks[g]++;
+        view.state = batch->state[g];
+        bool hold;
+        if (!config->policy->decide(&view, &policySeeds[g], &actions[g],
+                                    &hold)) {
+          actions[g] = kActionUp;
+        }
+      }
+      tetris_batchStep(batch, actions);
+    }
+  }
+  tetris_batchDestroy(batch);
+  free(actions);
+  free(policySeeds);
+  free(games);
+  free(ticks);
+}
+
+static int compareInts(const void* a, const void* b) {
+  int x = *(const int*)a;
+  int y = *(const int*)b;
+  return (x > y) - (x < y);
+}
+
+static void printReport(const SimConfig* config, const SimResult* results,
+                        double seconds) {
+  long long ticks = 0;
+  long long lines = 0;
+  long long scoreSum = 0;
+  long long decisions = 0;
+  double decisionMs = 0;
+  double slowestMs = 0;
+  int* scores = malloc(config->games * sizeof(int));
+  if (!scores) {
+    fprintf(stderr, "Failed to allocate score table\n");
+    return;
+  }
+  for (int i = 0; i < config->games; ++i) {
+    ticks += results[i].ticks;
+    lines += results[i].lines;
+    scoreSum += results[i].score;
+    scores[i] = results[i].score;
+    decisions += results[i].decisions;
+    decisionMs += results[i].decisionMs;
+    if (results[i].slowestMs > slowestMs) {
+      slowestMs = results[i].slowestMs;
+    }
+  }
+  qsort(scores, config->games, sizeof(int), compareInts);
+  int last = config->games - 1;
+
+  printf("policy %s, %s randomizer, %d games, %d threads, seed %llu\n",
+         config->policy->name,
+         config->randomizer == kRandomizerBag ? "bag" : "uniform",
+         config->games, config->threads, (unsigned long long)config->seed);
+  if (config->batchSize > 0) {
+    printf("batch engine, %d games per batch\n", config->batchSize);
+  }
+  if (config->policy->beam) {
+    printf("beam %d, preview %d, %d planner threads, budget %d ms, "
+           "cache 2^%d\n",
+           config->planner.beamWidth, config->planner.preview,
+           config->planner.threads, config->planner.budgetMs,
+           config->planner.cacheBits);
+  }
+  printf("time     %.3f s\n", seconds);
+  printf("games/s  %.1f\n", config->games / seconds);
+  printf("ticks/s  %.1f\n", ticks / seconds);
+  printf("lines/s  %.1f\n", lines / seconds);
+  printf("score    min %d  p10 %d  p50 %d  p90 %d  max %d  mean %.1f\n",
+         scores[0], scores[last / 10], scores[last / 2], scores[last * 9 / 10],
+         scores[last], (double)scoreSum / config->games);
+  if (decisions > 0) {
+    printf("decide   mean %.3f ms  max %.3f ms\n", decisionMs / decisions,
+           slowestMs);
+  }
+  free(scores);
+}
+
+static void printUsage(const char* program) {
+  fprintf(stderr,
+          "Usage: %s [-n games] [-j threads] [-s seed] [-t max_ticks] "
+          "[-p random|drop|idle|greedy|beam] [-r uniform|bag] "
+          "[-R replay_dir] [-w beam_width] [-q preview] [-T planner_threads] "
+          "[-b budget_ms] [-c cache_bits] [-k batch_size]\n",
+          program);
+}
+
+/**
+ * Entry point of the headless batch simulator.
+ * @return 0 on success, non-zero on invalid arguments or errors.
+ */
+int main(int argc, char* argv[]) {
+  SimConfig config = {.games = 1000,
+                      .threads = defaultThreadCount(),
+                      .seed = 1,
+                      .maxTicks = 1000000,
+                      .policy = &kPolicies[0],
+                      .randomizer = kRandomizerUniform,
+                      .planner = kDefaultPlannerConfig};
+  config.planner.threads = 0;
+  int opt;
+  while ((opt = getopt(argc, argv, "n:j:s:t:p:r:R:w:q:T:b:c:k:")) != -1) {
+    switch (opt) {
+      case 'n':
+        config.games = atoi(optarg);
+        break;
+      case 'j':
+        config.threads = atoi(optarg);
+        break;
+      case 's':
+        config.seed = strtoull(optarg, NULL, 10);
+        break;
+      case 't':
+        config.maxTicks = atol(optarg);
+        break;
+      case 'p':
+        config.policy = findPolicy(optarg);
+        break;
+      case 'r':
+        if (strcmp(optarg, "bag") == 0) {
+          config.randomizer = kRandomizerBag;
+        } else if (strcmp(optarg, "uniform") == 0) {
+          config.randomizer = kRandomizerUniform;
+        } else {
+          printUsage(argv[0]);
+          return 1;
+        }
+        break;
+      case 'R':
+        config.replayDir = optarg;
+        break;
+      case 'w':
+        config.planner.beamWidth = atoi(optarg);
+        break;
+      case 'q':
+        config.planner.preview = atoi(optarg);
+        break;
+      case 'T':
+        config.planner.threads = atoi(optarg);
+        break;
+      case 'b':
+        config.planner.budgetMs = atoi(optarg);
+        break;
+      case 'c':
+        config.planner.cacheBits = atoi(optarg);
+        break;
+      case 'k':
+        config.batchSize = atoi(optarg);
+        break;
+      default:
+        printUsage(argv[0]);
+        return 1;
+    }
+  }
+  PlannerConfig* planner = &config.planner;
+  if (config.games <= 0 || config.threads <= 0 || config.maxTicks <= 0 ||
+      !config.policy || planner->beamWidth <= 0 || planner->preview < 0 ||
+      planner->preview > kMaxPlannerPreview || planner->threads < 0 ||
+      planner->budgetMs <= 0 || planner->cacheBits < 0 ||
+      planner->cacheBits > 30 || config.batchSize < 0 ||
+      (config.batchSize > 0 &&
+       (!config.policy->decide || config.replayDir))) {
+    printUsage(argv[0]);
+    return 1;
+  }
+  // По умолчанию ядра, не занятые параллельными играми, отдаются планировщику.
+  if (planner->threads == 0) {
+    int games = config.games < config.threads ? config.games : config.threads;
+    planner->threads = defaultThreadCount() / games;
+    if (planner->threads < 1) {
+      planner->threads = 1;
+    }
+  }
+
+  SimResult* results = calloc(config.games, sizeof(SimResult));
+  if (!results) {
+    fprintf(stderr, "Failed to allocate results\n");
+    return 1;
+  }
+  SimRun run = {.config = &config, .results = results};
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  int status =
+      config.batchSize > 0
+          ? parallelFor(batchCount(&config), config.threads, simulateBatch,
+                        &run)
+          : parallelFor(config.games, config.threads, simulateGame, &run);
+  double seconds = elapsedSeconds(&start);
+  if (status == 0) {
+    printReport(&config, results, seconds);
+    int failed = 0;
+    for (int i = 0; i < config.games; ++i) {
+      failed += results[i].failed;
+    }
+    if (failed > 0) {
+      fprintf(stderr, "%d games failed\n", failed);
+      status = 1;
+    }
+  }
+  free(results);
+  return status;
+}